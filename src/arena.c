@@ -0,0 +1,208 @@
+// mmap and friends are POSIX, not part of C99, so ask for them explicitly
+// (has to come before any system header gets included)
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+struct arena_block {
+    arena_block_t* previous;
+    unsigned char* data; // aligned start of the usable bytes, right after this header
+    size_t size;         // usable bytes
+    size_t used;         // offset of the first free byte
+    size_t mapped_size;  // size of the pages mapped for this block, 0 if it came from malloc
+};
+
+// Whole pages straight from the OS, preferably huge ones (size must be a multiple of ARENA_HUGE_PAGE_SIZE)
+static void* allocate_pages(size_t size)
+{
+#ifdef _WIN32
+    // Large pages need the "Lock pages in memory" privilege, without it Windows refuses them
+    // and we settle for normal pages
+    SIZE_T large_page_size = GetLargePageMinimum();
+    if (large_page_size > 0 && size % large_page_size == 0)
+    {
+        void* pages = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (pages != NULL)
+            return pages;
+    }
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    // A huge page has to start at a huge page boundary, so map one extra
+    // and unmap whatever sticks out on both sides of the aligned range
+    size_t mapped_size = size + ARENA_HUGE_PAGE_SIZE;
+    unsigned char* memory = (unsigned char*)mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return NULL;
+
+    uintptr_t aligned = ((uintptr_t)memory + ARENA_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE_SIZE - 1);
+    size_t head = (size_t)(aligned - (uintptr_t)memory);
+    size_t tail = mapped_size - head - size;
+    if (head > 0)
+        munmap(memory, head);
+    if (tail > 0)
+        munmap((unsigned char*)aligned + size, tail);
+
+#ifdef MADV_HUGEPAGE
+    // Ask for transparent huge pages (Linux), only a hint, the kernel may still use normal ones
+    madvise((void*)aligned, size, MADV_HUGEPAGE);
+#endif
+    return (void*)aligned;
+#endif
+}
+
+static void free_pages(void* pages, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, size);
+#endif
+}
+
+static size_t align_size(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static arena_block_t* new_block(size_t size, arena_block_t* previous)
+{
+    // Header and data in one allocation, with room to align the data
+    size_t total_size = sizeof(arena_block_t) + ARENA_ALIGNMENT - 1 + size;
+
+    // Big blocks take whole huge pages (the rounding just makes the block bigger),
+    // so a scene's large buffers sit in a few TLB entries instead of hundreds
+    size_t mapped_size = 0;
+    unsigned char* memory = NULL;
+    if (total_size >= ARENA_HUGE_PAGE_MIN_BLOCK_SIZE)
+    {
+        mapped_size = (total_size + ARENA_HUGE_PAGE_SIZE - 1) & ~(size_t)(ARENA_HUGE_PAGE_SIZE - 1);
+        memory = (unsigned char*)allocate_pages(mapped_size);
+        if (memory != NULL)
+            size = mapped_size - (sizeof(arena_block_t) + ARENA_ALIGNMENT - 1);
+        else
+            mapped_size = 0;
+    }
+    if (memory == NULL)
+        memory = (unsigned char*)malloc(total_size);
+    if (memory == NULL)
+    {
+        fprintf(stderr, "Error allocating %lu bytes of arena memory.\n", (unsigned long)size);
+        return NULL;
+    }
+
+    arena_block_t* block = (arena_block_t*)memory;
+    uintptr_t data = (uintptr_t)(memory + sizeof(arena_block_t));
+    block->data = (unsigned char*)((data + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1));
+    block->size = size;
+    block->used = 0;
+    block->mapped_size = mapped_size;
+    block->previous = previous;
+    return block;
+}
+
+static void free_blocks(arena_block_t* block)
+{
+    while (block != NULL)
+    {
+        arena_block_t* previous = block->previous;
+        if (block->mapped_size > 0)
+            free_pages(block, block->mapped_size);
+        else
+            free(block);
+        block = previous;
+    }
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    // Rounding the sizes keeps every allocation aligned, since the block data is
+    size = align_size(size);
+
+    arena_block_t* block = arena->block;
+    if (block == NULL || block->size - block->used < size)
+    {
+        // Chain a new block, at least twice as big as the last one so a growing frame needs few of them
+        size_t block_size = ARENA_MIN_BLOCK_SIZE;
+        if (block != NULL && block->size * 2 > block_size)
+            block_size = block->size * 2;
+        if (size > block_size)
+            block_size = size;
+
+        block = new_block(block_size, arena->block);
+        if (block == NULL)
+            return NULL;
+        arena->block = block;
+    }
+
+    void* pointer = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+    return pointer;
+}
+
+void* arena_realloc(arena_t* arena, void* pointer, size_t old_size, size_t new_size)
+{
+    if (pointer == NULL)
+        return arena_alloc(arena, new_size);
+
+    old_size = align_size(old_size);
+    new_size = align_size(new_size);
+
+    // The most recent allocation of the current block only needs its end moved
+    arena_block_t* block = arena->block;
+    if ((unsigned char*)pointer + old_size == block->data + block->used &&
+        block->used - old_size + new_size <= block->size)
+    {
+        block->used = block->used - old_size + new_size;
+        arena->used = arena->used - old_size + new_size;
+        if (arena->used > arena->high_water)
+            arena->high_water = arena->used;
+        return pointer;
+    }
+
+    void* moved = arena_alloc(arena, new_size);
+    if (moved != NULL)
+        memcpy(moved, pointer, (old_size < new_size) ? old_size : new_size);
+    return moved;
+}
+
+void arena_reset(arena_t* arena)
+{
+    arena_block_t* block = arena->block;
+    if (block != NULL && block->previous != NULL)
+    {
+        // More than one block since the last reset: trade them for one block that fits the high-water mark,
+        // so the same amount of data goes in a single block from now on
+        free_blocks(block);
+        size_t block_size = align_size(arena->high_water);
+        arena->block = new_block(block_size > ARENA_MIN_BLOCK_SIZE ? block_size : ARENA_MIN_BLOCK_SIZE, NULL);
+    }
+    else if (block != NULL)
+    {
+        block->used = 0;
+    }
+    arena->used = 0;
+}
+
+void arena_free(arena_t* arena)
+{
+    free_blocks(arena->block);
+    arena->block = NULL;
+    arena->used = 0;
+    arena->high_water = 0;
+}
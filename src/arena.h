@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 32          // every allocation is aligned for the widest SIMD loads (AVX)
+#define ARENA_MIN_BLOCK_SIZE 65536
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)           // x86-64 huge page (and the usual Windows large page)
+#define ARENA_HUGE_PAGE_MIN_BLOCK_SIZE (1024 * 1024)     // blocks from this size on are made of huge pages
+
+typedef struct arena_block arena_block_t;
+
+// Linear (bump) allocator for data that only lives until the next reset, like everything
+// a frame computes for the next render. Allocating is a pointer increment and there is no free,
+// the whole arena is reset at once.
+//
+// When a block runs out a bigger one is chained, so pointers handed out earlier stay valid.
+// The reset after such a frame replaces the chain with a single block as big as the
+// most memory ever used (the high-water mark), so once the arena has seen the worst frame
+// every reset just rewinds one block, and no frame calls malloc or free.
+//
+// The same arena also works as a region for data with a longer lifetime, like all the assets of a scene:
+// allocate everything from it and release it all with a single arena_free, without resetting in between.
+// Blocks of ARENA_HUGE_PAGE_MIN_BLOCK_SIZE or more come straight from the OS in huge pages when
+// it lets us (and normal pages otherwise), which keeps big buffers contiguous and cheap on the TLB.
+//
+// There are no locks: each thread that needs transient memory should have its own arena.
+typedef struct {
+    arena_block_t* block; // current block, earlier blocks of this frame are linked behind it
+    size_t used;          // bytes handed out since the last reset, in all blocks
+    size_t high_water;    // most bytes ever handed out between two resets
+} arena_t;
+
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Grow (or shrink) the most recent allocation in place if there is room, otherwise move it
+// to a new allocation (the old space is only reclaimed by the next reset)
+void* arena_realloc(arena_t* arena, void* pointer, size_t old_size, size_t new_size);
+
+void arena_reset(arena_t* arena);
+void arena_free(arena_t* arena);
+
+#endif
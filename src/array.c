@@ -1,42 +1,98 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "array.h"
 
-#define ARRAY_RAW_DATA(array) ((int*)(array) - 2)
-#define ARRAY_CAPACITY(array) (ARRAY_RAW_DATA(array)[0])
-#define ARRAY_OCCUPIED(array) (ARRAY_RAW_DATA(array)[1])
+typedef struct {
+    size_t capacity;
+    size_t occupied;
+    void* memory; // start of the malloc'd block, the header sits wherever alignment put it
+} array_header_t;
 
-void* array_hold(void* array, int count, int item_size) {
+// The header takes a whole alignment unit, so the elements right after it stay aligned
+#define ARRAY_HEADER_SIZE ((sizeof(array_header_t) + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT)
+#define ARRAY_HEADER(array) ((array_header_t*)((char*)(array) - ARRAY_HEADER_SIZE))
+
+// Allocate room for capacity elements (aligned) and move the old elements there
+static void* array_allocate(void* array, size_t capacity, size_t item_size)
+{
+    // Beyond this the byte count doesn't fit in a size_t
+    if (item_size > 0 && capacity > (SIZE_MAX - ARRAY_HEADER_SIZE - ARRAY_ALIGNMENT) / item_size) {
+        fprintf(stderr, "Error: array of %lu elements is too large.\n", (unsigned long)capacity);
+        exit(EXIT_FAILURE);
+    }
+
+    // malloc only guarantees 16 byte alignment at best, so ask for some slack and align by hand
+    // (which is why growing an array can't use realloc, the alignment offset could change)
+    char* memory = (char*)malloc(ARRAY_HEADER_SIZE + ARRAY_ALIGNMENT - 1 + capacity * item_size);
+    if (memory == NULL) {
+        fprintf(stderr, "Error allocating an array of %lu elements.\n", (unsigned long)capacity);
+        exit(EXIT_FAILURE);
+    }
+    uintptr_t aligned = ((uintptr_t)memory + ARRAY_HEADER_SIZE + ARRAY_ALIGNMENT - 1) & ~(uintptr_t)(ARRAY_ALIGNMENT - 1);
+    char* new_array = (char*)aligned;
+
+    array_header_t* header = ARRAY_HEADER(new_array);
+    header->capacity = capacity;
+    header->occupied = 0;
+    header->memory = memory;
+
+    if (array != NULL) {
+        size_t occupied = ARRAY_HEADER(array)->occupied;
+        memcpy(new_array, array, occupied * item_size);
+        header->occupied = occupied;
+        array_free(array);
+    }
+    return new_array;
+}
+
+void* array_hold(void* array, size_t count, size_t item_size) {
     if (array == NULL) {
-        int raw_size = (sizeof(int) * 2) + (item_size * count);
-        int* base = (int*)malloc(raw_size);
-        base[0] = count;  // capacity
-        base[1] = count;  // occupied
-        return base + 2;
-    }
-    else if (ARRAY_OCCUPIED(array) + count <= ARRAY_CAPACITY(array)) {
-        ARRAY_OCCUPIED(array) += count;
+        array = array_allocate(NULL, count, item_size);
+        ARRAY_HEADER(array)->occupied = count;
         return array;
     }
-    else {
-        int needed_size = ARRAY_OCCUPIED(array) + count;
-        int double_curr = ARRAY_CAPACITY(array) * 2;
-        int capacity = needed_size > double_curr ? needed_size : double_curr;
-        int occupied = needed_size;
-        int raw_size = sizeof(int) * 2 + item_size * capacity;
-        int* base = (int*)realloc(ARRAY_RAW_DATA(array), raw_size);
-        base[0] = capacity;
-        base[1] = occupied;
-        return base + 2;
+
+    array_header_t* header = ARRAY_HEADER(array);
+    size_t needed_size = header->occupied + count;
+    if (needed_size > header->capacity) {
+        // Double the capacity, so pushing one element at a time stays amortized O(1)
+        size_t double_curr = header->capacity * 2;
+        array = array_allocate(array, needed_size > double_curr ? needed_size : double_curr, item_size);
+        header = ARRAY_HEADER(array);
     }
+    header->occupied = needed_size;
+    return array;
 }
 
-int array_length(void* array) {
-    return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
+void* array_set_capacity(void* array, size_t capacity, size_t item_size) {
+    if (capacity <= array_capacity(array)) {
+        return array;
+    }
+    return array_allocate(array, capacity, item_size);
+}
+
+void* array_set_length(void* array, size_t length, size_t item_size) {
+    size_t occupied = array_length(array);
+    if (length > occupied) {
+        return array_hold(array, length - occupied, item_size);
+    }
+    if (array != NULL) {
+        ARRAY_HEADER(array)->occupied = length;
+    }
+    return array;
+}
+
+size_t array_length(const void* array) {
+    return (array != NULL) ? ARRAY_HEADER(array)->occupied : 0;
+}
+
+size_t array_capacity(const void* array) {
+    return (array != NULL) ? ARRAY_HEADER(array)->capacity : 0;
 }
 
 void array_free(void* array) {
     if (array != NULL) {
-        free(ARRAY_RAW_DATA(array));
+        free(ARRAY_HEADER(array)->memory);
     }
-}
\ No newline at end of file
+}
@@ -1,14 +1,44 @@
 #ifndef ARRAY_H
 #define ARRAY_H
 
+#include <stddef.h>
+#include <string.h>
+
+// Dynamic arrays ("stretchy buffers"): a plain pointer to the first element,
+// with the capacity and length stored in a header right before it.
+// A NULL pointer is a valid empty array.
+// The elements always start at an ARRAY_ALIGNMENT boundary, so SIMD kernels can load them directly.
+#define ARRAY_ALIGNMENT 32
+
 #define array_push(array, value)                                              \
     do {                                                                      \
         (array) = array_hold((array), 1, sizeof(*(array)));                   \
         (array)[array_length(array) - 1] = (value);                           \
-    } while (0);
+    } while (0)
+
+// Append count elements copied from values
+#define array_push_n(array, values, count)                                    \
+    do {                                                                      \
+        size_t array_push_n_count = (count);                                  \
+        (array) = array_hold((array), array_push_n_count, sizeof(*(array)));  \
+        memcpy((array) + array_length(array) - array_push_n_count, (values),  \
+            array_push_n_count * sizeof(*(array)));                           \
+    } while (0)
+
+// Make room for capacity elements in total, so pushing up to there never reallocates
+#define array_reserve(array, capacity) \
+    ((array) = array_set_capacity((array), (capacity), sizeof(*(array))))
+
+// Set the number of elements, new elements are left uninitialized
+#define array_resize(array, length) \
+    ((array) = array_set_length((array), (length), sizeof(*(array))))
 
-void* array_hold(void* array, int count, int item_size);
-int array_length(void* array);
+// Add count elements at the end (uninitialized). With a NULL array it allocates exactly count elements.
+void* array_hold(void* array, size_t count, size_t item_size);
+void* array_set_capacity(void* array, size_t capacity, size_t item_size);
+void* array_set_length(void* array, size_t length, size_t item_size);
+size_t array_length(const void* array);
+size_t array_capacity(const void* array);
 void array_free(void* array);
 
-#endif
\ No newline at end of file
+#endif
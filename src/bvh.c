@@ -0,0 +1,556 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "array.h"
+#include "bvh.h"
+
+bvh_t scene_bvh = { NULL, NULL, NULL, NULL, 0, 0.0f, 0.0f };
+
+static float box_area(vec3_t box_min, vec3_t box_max)
+{
+    vec3_t size = vec3_sub(box_max, box_min);
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static void grow_box(vec3_t* box_min, vec3_t* box_max, vec3_t other_min, vec3_t other_max)
+{
+    box_min->x = fminf(box_min->x, other_min.x);
+    box_min->y = fminf(box_min->y, other_min.y);
+    box_min->z = fminf(box_min->z, other_min.z);
+    box_max->x = fmaxf(box_max->x, other_max.x);
+    box_max->y = fmaxf(box_max->y, other_max.y);
+    box_max->z = fmaxf(box_max->z, other_max.z);
+}
+
+static float vec3_component(vec3_t v, int axis)
+{
+    return (axis == 0) ? v.x : (axis == 1) ? v.y : v.z;
+}
+
+static float instance_centroid(const mesh_instance_t* instance, int axis)
+{
+    return 0.5f * (vec3_component(instance->bounds_min, axis) + vec3_component(instance->bounds_max, axis));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    int count;
+} bvh_bin_t;
+
+static int centroid_bin(float centroid, float centroid_min, float centroid_extent)
+{
+    int bin = (int)((centroid - centroid_min) / centroid_extent * BVH_NUM_BINS);
+    return (bin < BVH_NUM_BINS - 1) ? bin : BVH_NUM_BINS - 1;
+}
+
+// Split the instances first to first + count - 1 where the SAH is the lowest:
+// the instances are put in bins along each axis by their centroid, and each boundary between two bins
+// is a candidate split, costing the area of the box on each side times the number of instances in it
+// (the odds of a query reaching that side, times the work it then has). Returns the number of
+// instances that went to the left, after moving them to the front of the range.
+static int split_instances(bvh_t* bvh, const mesh_instance_t* instances, int first, int count)
+{
+    int* indices = &bvh->instance_indices[first];
+
+    vec3_t centroid_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3_t centroid_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = 0; i < count; i++)
+    {
+        const mesh_instance_t* instance = &instances[indices[i]];
+        vec3_t centroid = vec3_mul(vec3_add(instance->bounds_min, instance->bounds_max), 0.5f);
+        grow_box(&centroid_min, &centroid_max, centroid, centroid);
+    }
+
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    int best_bin = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float axis_min = vec3_component(centroid_min, axis);
+        float axis_extent = vec3_component(centroid_max, axis) - axis_min;
+        if (axis_extent <= 0.0f)
+            continue;
+
+        bvh_bin_t bins[BVH_NUM_BINS];
+        for (int b = 0; b < BVH_NUM_BINS; b++)
+            bins[b].count = 0; // the box of a bin is only set by its first instance
+        for (int i = 0; i < count; i++)
+        {
+            const mesh_instance_t* instance = &instances[indices[i]];
+            bvh_bin_t* bin = &bins[centroid_bin(instance_centroid(instance, axis), axis_min, axis_extent)];
+            if (bin->count == 0)
+            {
+                bin->bounds_min = instance->bounds_min;
+                bin->bounds_max = instance->bounds_max;
+            }
+            else
+                grow_box(&bin->bounds_min, &bin->bounds_max, instance->bounds_min, instance->bounds_max);
+            bin->count++;
+        }
+
+        // Sweep from the right for the cost of everything right of each boundary,
+        // then from the left adding the cost of what's left of it
+        float right_costs[BVH_NUM_BINS];
+        vec3_t side_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        vec3_t side_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        int side_count = 0;
+        for (int b = BVH_NUM_BINS - 1; b > 0; b--)
+        {
+            if (bins[b].count > 0)
+                grow_box(&side_min, &side_max, bins[b].bounds_min, bins[b].bounds_max);
+            side_count += bins[b].count;
+            right_costs[b] = (side_count > 0) ? box_area(side_min, side_max) * side_count : -1.0f;
+        }
+        side_min = (vec3_t){ FLT_MAX, FLT_MAX, FLT_MAX };
+        side_max = (vec3_t){ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        side_count = 0;
+        for (int b = 1; b < BVH_NUM_BINS; b++)
+        {
+            if (bins[b - 1].count > 0)
+                grow_box(&side_min, &side_max, bins[b - 1].bounds_min, bins[b - 1].bounds_max);
+            side_count += bins[b - 1].count;
+            if (side_count == 0 || right_costs[b] < 0.0f)
+                continue; // everything on one side, that's no split
+            float cost = box_area(side_min, side_max) * side_count + right_costs[b];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    // All the centroids in the same spot (or all in one bin): any split is as good as another
+    if (best_axis < 0)
+        return count / 2;
+
+    float axis_min = vec3_component(centroid_min, best_axis);
+    float axis_extent = vec3_component(centroid_max, best_axis) - axis_min;
+    int left = 0;
+    int right = count - 1;
+    while (left <= right)
+    {
+        if (centroid_bin(instance_centroid(&instances[indices[left]], best_axis), axis_min, axis_extent) < best_bin)
+            left++;
+        else
+        {
+            int swap = indices[left];
+            indices[left] = indices[right];
+            indices[right] = swap;
+            right--;
+        }
+    }
+    return left;
+}
+
+static void build_node(bvh_t* bvh, const mesh_instance_t* instances, int node_index, int first, int count, int* num_nodes)
+{
+    bvh_node_t* node = &bvh->nodes[node_index];
+    node->bounds_min = instances[bvh->instance_indices[first]].bounds_min;
+    node->bounds_max = instances[bvh->instance_indices[first]].bounds_max;
+    for (int i = first + 1; i < first + count; i++)
+        grow_box(&node->bounds_min, &node->bounds_max, instances[bvh->instance_indices[i]].bounds_min, instances[bvh->instance_indices[i]].bounds_max);
+
+    if (count <= BVH_MAX_LEAF_INSTANCES)
+    {
+        node->first = first;
+        node->count = count;
+        for (int i = first; i < first + count; i++)
+            bvh->instance_leaves[bvh->instance_indices[i]] = node_index;
+        return;
+    }
+
+    int num_left = split_instances(bvh, instances, first, count);
+    int left_child = *num_nodes;
+    *num_nodes += 2;
+    node->first = left_child;
+    node->count = 0;
+    bvh->parents[left_child] = node_index;
+    bvh->parents[left_child + 1] = node_index;
+    build_node(bvh, instances, left_child, first, num_left, num_nodes);
+    build_node(bvh, instances, left_child + 1, first + num_left, count - num_left, num_nodes);
+}
+
+static float tree_cost(const bvh_t* bvh)
+{
+    float root_area = box_area(bvh->nodes[0].bounds_min, bvh->nodes[0].bounds_max);
+    return (root_area > 0.0f) ? bvh->total_area / root_area : 1.0f;
+}
+
+void bvh_build(bvh_t* bvh, const scene_t* scene)
+{
+    int num_instances = scene_num_instances(scene);
+    bvh->num_instances = num_instances;
+    array_resize(bvh->instance_indices, num_instances);
+    array_resize(bvh->instance_leaves, num_instances);
+    if (num_instances == 0)
+    {
+        array_resize(bvh->nodes, 0);
+        array_resize(bvh->parents, 0);
+        return;
+    }
+
+    // A binary tree with leaves of at least one instance has at most 2n - 1 nodes
+    array_resize(bvh->nodes, 2 * num_instances - 1);
+    array_resize(bvh->parents, 2 * num_instances - 1);
+    for (int i = 0; i < num_instances; i++)
+        bvh->instance_indices[i] = i;
+
+    int num_nodes = 1;
+    bvh->parents[0] = -1;
+    build_node(bvh, scene->instances, 0, 0, num_instances, &num_nodes);
+    array_resize(bvh->nodes, num_nodes);
+    array_resize(bvh->parents, num_nodes);
+
+    bvh->total_area = 0.0f;
+    for (int i = 0; i < num_nodes; i++)
+        bvh->total_area += box_area(bvh->nodes[i].bounds_min, bvh->nodes[i].bounds_max);
+    bvh->build_cost = tree_cost(bvh);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Refit
+///////////////////////////////////////////////////////////////////////////////
+// Recompute the box of a node from its children (or its instances), return whether it changed
+static bool refit_node(bvh_t* bvh, const mesh_instance_t* instances, int node_index)
+{
+    bvh_node_t* node = &bvh->nodes[node_index];
+    vec3_t bounds_min, bounds_max;
+    if (node->count > 0)
+    {
+        bounds_min = instances[bvh->instance_indices[node->first]].bounds_min;
+        bounds_max = instances[bvh->instance_indices[node->first]].bounds_max;
+        for (int i = node->first + 1; i < node->first + node->count; i++)
+            grow_box(&bounds_min, &bounds_max, instances[bvh->instance_indices[i]].bounds_min, instances[bvh->instance_indices[i]].bounds_max);
+    }
+    else
+    {
+        bounds_min = bvh->nodes[node->first].bounds_min;
+        bounds_max = bvh->nodes[node->first].bounds_max;
+        grow_box(&bounds_min, &bounds_max, bvh->nodes[node->first + 1].bounds_min, bvh->nodes[node->first + 1].bounds_max);
+    }
+
+    if (memcmp(&bounds_min, &node->bounds_min, sizeof(vec3_t)) == 0 && memcmp(&bounds_max, &node->bounds_max, sizeof(vec3_t)) == 0)
+        return false;
+    bvh->total_area += box_area(bounds_min, bounds_max) - box_area(node->bounds_min, node->bounds_max);
+    node->bounds_min = bounds_min;
+    node->bounds_max = bounds_max;
+    return true;
+}
+
+void bvh_update(bvh_t* bvh, const scene_t* scene)
+{
+    int num_instances = scene_num_instances(scene);
+    if (num_instances != bvh->num_instances)
+    {
+        bvh_build(bvh, scene);
+        return;
+    }
+
+    int num_moved = (int)array_length(scene->moved_instances);
+    if (num_moved == 0)
+        return;
+
+    if (num_moved * BVH_FULL_REFIT_RATIO >= num_instances)
+    {
+        // Children come after their parents, so going backwards refits them first
+        for (int i = (int)array_length(bvh->nodes) - 1; i >= 0; i--)
+            refit_node(bvh, scene->instances, i);
+    }
+    else
+    {
+        // Walk up from the leaf of each moved instance, until a box doesn't change
+        // (then the ones above it don't need to either, as far as this instance goes)
+        for (int i = 0; i < num_moved; i++)
+        {
+            int node_index = bvh->instance_leaves[scene->moved_instances[i]];
+            while (node_index >= 0 && refit_node(bvh, scene->instances, node_index))
+                node_index = bvh->parents[node_index];
+        }
+    }
+
+    if (tree_cost(bvh) > bvh->build_cost * BVH_REBUILD_COST_RATIO)
+        bvh_build(bvh, scene);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Frustum culling
+///////////////////////////////////////////////////////////////////////////////
+// Bit i of the plane masks is set while plane i still needs testing. A node entirely inside a plane
+// has all of its descendants inside it too, so they skip that plane, and a node inside all of them
+// has all of its instances visible without any more tests.
+static bool box_outside_planes(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t box_min, vec3_t box_max, unsigned* plane_mask)
+{
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; i++)
+    {
+        if (!(*plane_mask & (1u << i)))
+            continue;
+
+        // Corner furthest along the normal outside: the whole box is. Closest corner inside: the whole box is.
+        vec3_t far_corner = {
+            (planes[i].x >= 0.0f) ? box_max.x : box_min.x,
+            (planes[i].y >= 0.0f) ? box_max.y : box_min.y,
+            (planes[i].z >= 0.0f) ? box_max.z : box_min.z
+        };
+        if (planes[i].x * far_corner.x + planes[i].y * far_corner.y + planes[i].z * far_corner.z + planes[i].w < 0.0f)
+            return true;
+
+        vec3_t near_corner = {
+            (planes[i].x >= 0.0f) ? box_min.x : box_max.x,
+            (planes[i].y >= 0.0f) ? box_min.y : box_max.y,
+            (planes[i].z >= 0.0f) ? box_min.z : box_max.z
+        };
+        if (planes[i].x * near_corner.x + planes[i].y * near_corner.y + planes[i].z * near_corner.z + planes[i].w >= 0.0f)
+            *plane_mask &= ~(1u << i);
+    }
+    return false;
+}
+
+static bool sphere_outside_planes(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t center, float radius, unsigned plane_mask)
+{
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; i++)
+    {
+        if ((plane_mask & (1u << i)) &&
+            planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w < -radius)
+            return true;
+    }
+    return false;
+}
+
+static void cull_node(const bvh_t* bvh, const mesh_instance_t* instances, const vec4_t planes[NUM_FRUSTUM_PLANES],
+    int node_index, unsigned plane_mask, int* visible_instances, int* num_visible)
+{
+    const bvh_node_t* node = &bvh->nodes[node_index];
+    if (plane_mask != 0 && box_outside_planes(planes, node->bounds_min, node->bounds_max, &plane_mask))
+        return;
+
+    if (node->count == 0)
+    {
+        cull_node(bvh, instances, planes, node->first, plane_mask, visible_instances, num_visible);
+        cull_node(bvh, instances, planes, node->first + 1, plane_mask, visible_instances, num_visible);
+        return;
+    }
+
+    for (int i = node->first; i < node->first + node->count; i++)
+    {
+        const mesh_instance_t* instance = &instances[bvh->instance_indices[i]];
+        unsigned instance_mask = plane_mask;
+        if (instance_mask != 0 &&
+            (sphere_outside_planes(planes, instance->bounds_center, instance->bounds_radius, instance_mask) ||
+             box_outside_planes(planes, instance->bounds_min, instance->bounds_max, &instance_mask)))
+            continue;
+        visible_instances[(*num_visible)++] = bvh->instance_indices[i];
+    }
+}
+
+int bvh_cull_frustum(const bvh_t* bvh, const scene_t* scene, const vec4_t planes[NUM_FRUSTUM_PLANES], int* visible_instances)
+{
+    int num_visible = 0;
+    if (array_length(bvh->nodes) == 0)
+        return 0;
+
+    int num_planes = far_plane_clipping ? NUM_FRUSTUM_PLANES : FRUSTUM_FAR;
+    cull_node(bvh, scene->instances, planes, 0, (1u << num_planes) - 1, visible_instances, &num_visible);
+    return num_visible;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Ray queries
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    vec3_t origin;
+    vec3_t direction;
+    vec3_t inverse_direction; // 1 / direction per axis (infinite for a 0 component)
+} ray_t;
+
+// Slab test: where the ray enters the box, if it does before max_distance
+static bool ray_hits_box(const ray_t* ray, vec3_t box_min, vec3_t box_max, float max_distance, float* entry_distance)
+{
+    float near = 0.0f;
+    float far = max_distance;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float origin = vec3_component(ray->origin, axis);
+        float inverse = vec3_component(ray->inverse_direction, axis);
+        float t0 = (vec3_component(box_min, axis) - origin) * inverse;
+        float t1 = (vec3_component(box_max, axis) - origin) * inverse;
+        // fminf/fmaxf drop the NaN of a ray in the plane of a slab (0 * infinity), which then doesn't limit it
+        near = fmaxf(near, fminf(t0, t1));
+        far = fminf(far, fmaxf(t0, t1));
+    }
+    *entry_distance = near;
+    return near <= far;
+}
+
+// Closest hit of the ray with the triangles of the full detail mesh of the instance, closer than *distance.
+// The ray goes to object space, where the parameter along it stays the same (the direction isn't renormalized),
+// and the meshlet bounding spheres skip the faces it can't come near.
+static bool ray_hits_instance(const ray_t* ray, const mesh_instance_t* instance, float* distance)
+{
+    mat4_t world_inverse;
+    if (!mat4_inverse(instance->transform.world_matrix, &world_inverse))
+        return false;
+    vec3_t origin = vec3_from_vec4(mat4_mul_vec4(world_inverse, vec4_from_vec3(ray->origin)));
+    vec4_t world_direction = { ray->direction.x, ray->direction.y, ray->direction.z, 0.0f };
+    vec3_t direction = vec3_from_vec4(mat4_mul_vec4(world_inverse, world_direction));
+    float direction_length_squared = vec3_dot(direction, direction);
+
+    const mesh_t* mesh = instance->mesh;
+    const mesh_lod_t* lod = &mesh->lods[0];
+    bool hit = false;
+    for (int m = 0; m < lod->num_meshlets; m++)
+    {
+        // Closest point of the ray to the sphere center
+        const meshlet_t* meshlet = &lod->meshlets[m];
+        vec3_t to_center = vec3_sub(meshlet->center, origin);
+        float t = vec3_dot(to_center, direction) / direction_length_squared;
+        vec3_t offset = vec3_sub(to_center, vec3_mul(direction, t));
+        float radius_t = meshlet->radius / sqrtf(direction_length_squared);
+        if (vec3_dot(offset, offset) > meshlet->radius * meshlet->radius || t + radius_t < 0.0f || t - radius_t > *distance)
+            continue;
+
+        // Moller-Trumbore, from both sides: picking doesn't care where the faces point
+        for (int f = meshlet->first_face; f < meshlet->first_face + meshlet->num_faces; f++)
+        {
+            vec3_t a = mesh->vertices[mesh->indices[f * 3 + 0]];
+            vec3_t edge1 = vec3_sub(mesh->vertices[mesh->indices[f * 3 + 1]], a);
+            vec3_t edge2 = vec3_sub(mesh->vertices[mesh->indices[f * 3 + 2]], a);
+            vec3_t p = vec3_cross(direction, edge2);
+            float determinant = vec3_dot(edge1, p);
+            if (fabsf(determinant) < 1e-12f)
+                continue;
+            float inverse_determinant = 1.0f / determinant;
+            vec3_t s = vec3_sub(origin, a);
+            float u = vec3_dot(s, p) * inverse_determinant;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            vec3_t q = vec3_cross(s, edge1);
+            float v = vec3_dot(direction, q) * inverse_determinant;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            float hit_t = vec3_dot(edge2, q) * inverse_determinant;
+            if (hit_t >= 0.0f && hit_t < *distance)
+            {
+                *distance = hit_t;
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+// Children in the order the ray enters them, so the nearer hit shrinks the distance before the other is looked at
+static void raycast_node(const bvh_t* bvh, const mesh_instance_t* instances, const ray_t* ray, int node_index, int* hit_instance, float* distance)
+{
+    const bvh_node_t* node = &bvh->nodes[node_index];
+    if (node->count > 0)
+    {
+        for (int i = node->first; i < node->first + node->count; i++)
+        {
+            const mesh_instance_t* instance = &instances[bvh->instance_indices[i]];
+            float entry;
+            if (ray_hits_box(ray, instance->bounds_min, instance->bounds_max, *distance, &entry) &&
+                ray_hits_instance(ray, instance, distance))
+                *hit_instance = bvh->instance_indices[i];
+        }
+        return;
+    }
+
+    int children[2] = { node->first, node->first + 1 };
+    float entries[2];
+    bool hits[2];
+    for (int c = 0; c < 2; c++)
+        hits[c] = ray_hits_box(ray, bvh->nodes[children[c]].bounds_min, bvh->nodes[children[c]].bounds_max, *distance, &entries[c]);
+    int first = (hits[1] && (!hits[0] || entries[1] < entries[0])) ? 1 : 0;
+    for (int c = first; c < first + 2; c++)
+    {
+        int child = c % 2;
+        if (hits[child] && entries[child] <= *distance)
+            raycast_node(bvh, instances, ray, children[child], hit_instance, distance);
+    }
+}
+
+int bvh_raycast(const bvh_t* bvh, const scene_t* scene, vec3_t origin, vec3_t direction, float max_distance, float* hit_distance)
+{
+    int hit_instance = -1;
+    float distance = max_distance;
+    float entry;
+    ray_t ray = { origin, direction, { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z } };
+    if (array_length(bvh->nodes) > 0 && ray_hits_box(&ray, bvh->nodes[0].bounds_min, bvh->nodes[0].bounds_max, distance, &entry))
+        raycast_node(bvh, scene->instances, &ray, 0, &hit_instance, &distance);
+    *hit_distance = distance;
+    return hit_instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Nearest instance
+///////////////////////////////////////////////////////////////////////////////
+static float box_distance(vec3_t point, vec3_t box_min, vec3_t box_max)
+{
+    vec3_t outside = {
+        fmaxf(fmaxf(box_min.x - point.x, 0.0f), point.x - box_max.x),
+        fmaxf(fmaxf(box_min.y - point.y, 0.0f), point.y - box_max.y),
+        fmaxf(fmaxf(box_min.z - point.z, 0.0f), point.z - box_max.z)
+    };
+    return vec3_length(outside);
+}
+
+static void nearest_node(const bvh_t* bvh, const mesh_instance_t* instances, vec3_t point, int node_index, int* nearest_instance, float* distance)
+{
+    const bvh_node_t* node = &bvh->nodes[node_index];
+    if (node->count > 0)
+    {
+        for (int i = node->first; i < node->first + node->count; i++)
+        {
+            const mesh_instance_t* instance = &instances[bvh->instance_indices[i]];
+            float instance_distance = box_distance(point, instance->bounds_min, instance->bounds_max);
+            if (instance_distance < *distance)
+            {
+                *distance = instance_distance;
+                *nearest_instance = bvh->instance_indices[i];
+            }
+        }
+        return;
+    }
+
+    // Closer child first, the further one is skipped if it can't beat what the closer one found
+    int children[2] = { node->first, node->first + 1 };
+    float distances[2];
+    for (int c = 0; c < 2; c++)
+        distances[c] = box_distance(point, bvh->nodes[children[c]].bounds_min, bvh->nodes[children[c]].bounds_max);
+    int first = (distances[1] < distances[0]) ? 1 : 0;
+    for (int c = first; c < first + 2; c++)
+    {
+        int child = c % 2;
+        if (distances[child] < *distance)
+            nearest_node(bvh, instances, point, children[child], nearest_instance, distance);
+    }
+}
+
+int bvh_nearest(const bvh_t* bvh, const scene_t* scene, vec3_t point, float max_distance, float* result_distance)
+{
+    int nearest_instance = -1;
+    float distance = max_distance;
+    if (array_length(bvh->nodes) > 0)
+        nearest_node(bvh, scene->instances, point, 0, &nearest_instance, &distance);
+    *result_distance = distance;
+    return nearest_instance;
+}
+
+void bvh_free(bvh_t* bvh)
+{
+    array_free(bvh->nodes);
+    array_free(bvh->parents);
+    array_free(bvh->instance_indices);
+    array_free(bvh->instance_leaves);
+    bvh->nodes = NULL;
+    bvh->parents = NULL;
+    bvh->instance_indices = NULL;
+    bvh->instance_leaves = NULL;
+    bvh->num_instances = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "clipping.h"
+#include "scene.h"
+
+// Bounding volume hierarchy over the world bounds of the scene instances, so culling and spatial queries
+// skip whole groups of instances at once instead of looking at every one of them.
+//
+// It's a binary tree of axis aligned boxes, built top down by splitting the instances where the
+// surface area heuristic (SAH) says rays and frusta will visit the fewest nodes.
+// When instances move, the boxes above them are refit (the tree stays the same, only the boxes grow or shrink),
+// which is a lot cheaper than a rebuild but makes the tree worse the further things drift from where they
+// were at build time. bvh_update rebuilds it when that gets past BVH_REBUILD_COST_RATIO.
+#define BVH_MAX_LEAF_INSTANCES 4 // leaves get split until they have at most this many instances
+#define BVH_NUM_BINS 12          // candidate split positions per axis for the SAH
+#define BVH_REBUILD_COST_RATIO 1.5f // rebuild when refits made the tree this much more costly than at build time
+#define BVH_FULL_REFIT_RATIO 4   // refit the whole tree (rather than the paths above the moved instances) when 1/4 of them moved
+
+typedef struct {
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    int first; // leaf: first of its instances in bvh_t.instance_indices, internal node: index of its left child (the right one follows it)
+    int count; // number of instances of a leaf, 0 for internal nodes
+} bvh_node_t;
+
+typedef struct {
+    bvh_node_t* nodes;     // nodes[0] is the root, children always come after their parent (array.h arrays, like all below)
+    int* parents;          // parent node of every node (-1 for the root)
+    int* instance_indices; // instances of the leaves, each leaf has a range of them
+    int* instance_leaves;  // leaf node of every instance of the scene
+    int num_instances;     // how many instances the scene had when the tree was built
+    float total_area;      // sum of the surface areas of all the nodes, kept up to date by the refits
+    float build_cost;      // total_area over the area of the root right after the build
+} bvh_t;
+
+extern bvh_t scene_bvh;
+
+void bvh_build(bvh_t* bvh, const scene_t* scene);
+
+// Refit the nodes above the instances moved by the last scene_update_transforms,
+// or rebuild the tree when instances were added or the refits made it too costly
+void bvh_update(bvh_t* bvh, const scene_t* scene);
+
+// Write to visible_instances the index of every instance not entirely outside the frustum planes
+// (see extract_frustum_planes, in world space) and return how many there are
+int bvh_cull_frustum(const bvh_t* bvh, const scene_t* scene, const vec4_t planes[NUM_FRUSTUM_PLANES], int* visible_instances);
+
+// First instance hit by the ray from origin along direction (unit length), against the triangles of
+// its full detail mesh, no further than max_distance. Returns its index, and its distance in hit_distance,
+// or -1 if the ray hits nothing.
+int bvh_raycast(const bvh_t* bvh, const scene_t* scene, vec3_t origin, vec3_t direction, float max_distance, float* hit_distance);
+
+// Instance with the closest bounding box to point (0 if the point is inside it), no further than max_distance.
+// Returns its index, and the distance in result_distance, or -1 if there are none that close.
+int bvh_nearest(const bvh_t* bvh, const scene_t* scene, vec3_t point, float max_distance, float* result_distance);
+
+void bvh_free(bvh_t* bvh);
+
+#endif
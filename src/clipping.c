@@ -0,0 +1,229 @@
+#include <math.h>
+#include "clipping.h"
+
+bool far_plane_clipping = false;
+
+///////////////////////////////////////////////////////////////////////////////
+// Outcode of a vertex that already went through the projection kernel
+// (screen x and y, z/w and w, see vertex_stream.h).
+// Testing the screen coordinates is the same as testing the clip space ones
+// as long as the vertex is in front of the camera, which is the first thing we check.
+// Behind the camera the screen coordinates are garbage, so the vertex only gets CLIP_NEAR.
+///////////////////////////////////////////////////////////////////////////////
+uint32_t screen_outcode(vec4_t projected_vertex, float viewport_width, float viewport_height)
+{
+    // (written so a NaN w/z also counts as outside)
+    if (!(projected_vertex.w > 0.0f) || !(projected_vertex.z >= 0.0f))
+        return CLIP_NEAR;
+
+    uint32_t outcode = 0;
+    if (far_plane_clipping && projected_vertex.z > 1.0f)
+        outcode |= CLIP_FAR;
+
+    // Screen edges
+    if (projected_vertex.x < 0.0f)
+        outcode |= CLIP_SCREEN_LEFT;
+    if (projected_vertex.x > viewport_width)
+        outcode |= CLIP_SCREEN_RIGHT;
+    if (projected_vertex.y > viewport_height) // remember screen y points down
+        outcode |= CLIP_SCREEN_BOTTOM;
+    if (projected_vertex.y < 0.0f)
+        outcode |= CLIP_SCREEN_TOP;
+
+    // Guard band edges, (GUARD_BAND_SCALE - 1) half screens past the screen edges
+    float guard_x = (GUARD_BAND_SCALE - 1.0f) * viewport_width / 2.0f;
+    float guard_y = (GUARD_BAND_SCALE - 1.0f) * viewport_height / 2.0f;
+    if (projected_vertex.x < -guard_x)
+        outcode |= CLIP_GUARD_LEFT;
+    if (projected_vertex.x > viewport_width + guard_x)
+        outcode |= CLIP_GUARD_RIGHT;
+    if (projected_vertex.y > viewport_height + guard_y)
+        outcode |= CLIP_GUARD_BOTTOM;
+    if (projected_vertex.y < -guard_y)
+        outcode |= CLIP_GUARD_TOP;
+
+    return outcode;
+}
+
+polygon_t polygon_from_triangle(vec4_t v0, vec4_t v1, vec4_t v2, tex2_t t0, tex2_t t1, tex2_t t2)
+{
+    polygon_t polygon = {
+        .vertices = { v0, v1, v2 },
+        .texcoords = { t0, t1, t2 },
+        .num_vertices = 3
+    };
+    return polygon;
+}
+
+// Signed distance of a clip space vertex from a clipping plane, positive inside
+static float plane_distance(vec4_t v, uint32_t plane)
+{
+    switch (plane)
+    {
+        case CLIP_NEAR: return v.z;
+        case CLIP_FAR: return v.w - v.z;
+        case CLIP_GUARD_LEFT: return v.x + GUARD_BAND_SCALE * v.w;
+        case CLIP_GUARD_RIGHT: return GUARD_BAND_SCALE * v.w - v.x;
+        case CLIP_GUARD_BOTTOM: return v.y + GUARD_BAND_SCALE * v.w;
+        case CLIP_GUARD_TOP: return GUARD_BAND_SCALE * v.w - v.y;
+        default: return 0.0f;
+    }
+}
+
+static float lerp(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sutherland-Hodgman: walk the polygon edges, keeping the inside vertices
+// and adding a new vertex wherever an edge crosses the plane.
+// Positions and texcoords are interpolated linearly, which is correct in clip space
+// (before the perspective divide everything is still linear).
+///////////////////////////////////////////////////////////////////////////////
+static void clip_polygon_against_plane(polygon_t* polygon, uint32_t plane)
+{
+    vec4_t inside_vertices[MAX_NUM_POLY_VERTICES];
+    tex2_t inside_texcoords[MAX_NUM_POLY_VERTICES];
+    int num_inside_vertices = 0;
+
+    int previous = polygon->num_vertices - 1;
+    float previous_distance = plane_distance(polygon->vertices[previous], plane);
+
+    for (int current = 0; current < polygon->num_vertices; current++)
+    {
+        float current_distance = plane_distance(polygon->vertices[current], plane);
+
+        // The edge crosses the plane, add the intersection point
+        if ((current_distance >= 0.0f) != (previous_distance >= 0.0f))
+        {
+            float t = previous_distance / (previous_distance - current_distance);
+            vec4_t a = polygon->vertices[previous];
+            vec4_t b = polygon->vertices[current];
+            tex2_t a_uv = polygon->texcoords[previous];
+            tex2_t b_uv = polygon->texcoords[current];
+
+            vec4_t intersection = { lerp(a.x, b.x, t), lerp(a.y, b.y, t), lerp(a.z, b.z, t), lerp(a.w, b.w, t) };
+            tex2_t intersection_uv = { lerp(a_uv.u, b_uv.u, t), lerp(a_uv.v, b_uv.v, t) };
+            inside_vertices[num_inside_vertices] = intersection;
+            inside_texcoords[num_inside_vertices] = intersection_uv;
+            num_inside_vertices++;
+        }
+
+        if (current_distance >= 0.0f)
+        {
+            inside_vertices[num_inside_vertices] = polygon->vertices[current];
+            inside_texcoords[num_inside_vertices] = polygon->texcoords[current];
+            num_inside_vertices++;
+        }
+
+        previous = current;
+        previous_distance = current_distance;
+    }
+
+    for (int i = 0; i < num_inside_vertices; i++)
+    {
+        polygon->vertices[i] = inside_vertices[i];
+        polygon->texcoords[i] = inside_texcoords[i];
+    }
+    polygon->num_vertices = num_inside_vertices;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clip the polygon against every plane in planes (CLIP_* bits).
+// The polygon can end up with less than 3 vertices if it was entirely outside.
+///////////////////////////////////////////////////////////////////////////////
+void clip_polygon(polygon_t* polygon, uint32_t planes)
+{
+    for (uint32_t plane = CLIP_NEAR; plane <= CLIP_GUARD_TOP; plane <<= 1)
+    {
+        if ((planes & plane) && polygon->num_vertices >= 3)
+            clip_polygon_against_plane(polygon, plane);
+    }
+}
+
+// Perspective divide and viewport mapping of a clipped vertex,
+// the same operations the projection kernel does on the mesh vertices
+vec4_t clip_to_screen(vec4_t clip_vertex, float viewport_width, float viewport_height)
+{
+    float half_width = viewport_width / 2.0f;
+    float half_height = viewport_height / 2.0f;
+
+    vec4_t screen_vertex = {
+        (clip_vertex.x / clip_vertex.w) * half_width + half_width,
+        (clip_vertex.y / clip_vertex.w) * -half_height + half_height,
+        clip_vertex.z / clip_vertex.w,
+        clip_vertex.w
+    };
+    return screen_vertex;
+}
+
+// Plane a + sign * b, from two rows of a matrix
+static vec4_t combine_rows(const float a[4], const float b[4], float sign)
+{
+    vec4_t plane = { a[0] + sign * b[0], a[1] + sign * b[1], a[2] + sign * b[2], a[3] + sign * b[3] };
+    return plane;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Frustum planes from a (world-view-)projection matrix (Gribb/Hartmann).
+// A point p is inside the clip space plane x >= -w when row0 . p + row3 . p >= 0,
+// so row3 + row0 is that plane in the space p lives in, and the same for the others.
+///////////////////////////////////////////////////////////////////////////////
+void extract_frustum_planes(const mat4_t* matrix, vec4_t planes[NUM_FRUSTUM_PLANES])
+{
+    const float (*m)[4] = matrix->m;
+    vec4_t near_plane = { m[2][0], m[2][1], m[2][2], m[2][3] }; // 0 <= z
+
+    planes[FRUSTUM_LEFT] = combine_rows(m[3], m[0], 1.0f);    // -w <= x
+    planes[FRUSTUM_RIGHT] = combine_rows(m[3], m[0], -1.0f);  // x <= w
+    planes[FRUSTUM_BOTTOM] = combine_rows(m[3], m[1], 1.0f);  // -w <= y
+    planes[FRUSTUM_TOP] = combine_rows(m[3], m[1], -1.0f);    // y <= w
+    planes[FRUSTUM_NEAR] = near_plane;
+    planes[FRUSTUM_FAR] = combine_rows(m[3], m[2], -1.0f);    // z <= w
+
+    // Unit normals, so the plane equations give actual distances to compare radii with
+    for (int i = 0; i < NUM_FRUSTUM_PLANES; i++)
+    {
+        vec4_t* plane = &planes[i];
+        float length = sqrtf(plane->x * plane->x + plane->y * plane->y + plane->z * plane->z);
+        if (length > 0.0f)
+        {
+            plane->x /= length;
+            plane->y /= length;
+            plane->z /= length;
+            plane->w /= length;
+        }
+    }
+}
+
+// Is the sphere entirely on the outside of one of the frustum planes?
+bool sphere_outside_frustum(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t center, float radius)
+{
+    int num_planes = far_plane_clipping ? NUM_FRUSTUM_PLANES : FRUSTUM_FAR;
+    for (int i = 0; i < num_planes; i++)
+    {
+        float distance = planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w;
+        if (distance < -radius)
+            return true;
+    }
+    return false;
+}
+
+// Is the axis aligned box entirely on the outside of one of the frustum planes?
+// Only the corner furthest along the plane normal needs checking, if it's outside they all are.
+bool box_outside_frustum(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t box_min, vec3_t box_max)
+{
+    int num_planes = far_plane_clipping ? NUM_FRUSTUM_PLANES : FRUSTUM_FAR;
+    for (int i = 0; i < num_planes; i++)
+    {
+        vec3_t corner = {
+            (planes[i].x >= 0.0f) ? box_max.x : box_min.x,
+            (planes[i].y >= 0.0f) ? box_max.y : box_min.y,
+            (planes[i].z >= 0.0f) ? box_max.z : box_min.z
+        };
+        if (planes[i].x * corner.x + planes[i].y * corner.y + planes[i].z * corner.z + planes[i].w < 0.0f)
+            return true;
+    }
+    return false;
+}
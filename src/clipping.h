@@ -0,0 +1,72 @@
+#ifndef CLIPPING_H
+#define CLIPPING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+#include "texture.h"
+
+// Triangles are clipped in homogeneous clip space (before the perspective divide),
+// where the view frustum is 0 <= z <= w, -w <= x <= w and -w <= y <= w.
+//
+// Only the near plane (and the far plane, if enabled) gets clipped exactly, as the
+// perspective divide is meaningless behind the camera. For the 4 sides we rely on a guard band:
+// triangles that stay within GUARD_BAND_SCALE times the screen size are rasterized as they are,
+// and the rasterizer skips the pixels that fall outside of the screen.
+// Only the (rare) triangles reaching past the guard band get clipped against its edges,
+// so the rasterizer never has to deal with huge coordinates.
+#define GUARD_BAND_SCALE 4.0f
+
+// One triangle clipped by the near, far and 4 guard band planes can gain one vertex per plane
+#define MAX_NUM_POLY_VERTICES (3 + 6)
+
+// Outcode bits, telling on which side of the clipping planes a vertex is
+enum {
+    CLIP_NEAR = 1 << 0,
+    CLIP_FAR = 1 << 1,
+    CLIP_GUARD_LEFT = 1 << 2, // outside the guard band
+    CLIP_GUARD_RIGHT = 1 << 3,
+    CLIP_GUARD_BOTTOM = 1 << 4,
+    CLIP_GUARD_TOP = 1 << 5,
+    CLIP_SCREEN_LEFT = 1 << 6, // outside the screen, never clipped but enough to reject a whole triangle
+    CLIP_SCREEN_RIGHT = 1 << 7,
+    CLIP_SCREEN_BOTTOM = 1 << 8,
+    CLIP_SCREEN_TOP = 1 << 9
+};
+#define CLIP_PLANES (CLIP_NEAR | CLIP_FAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP)
+
+// Off by default: like before clipping existed, far away geometry is still drawn
+extern bool far_plane_clipping;
+
+// The view frustum as 6 planes: (x, y, z) a unit normal pointing inside, and w the offset,
+// so dot(normal, p) + w is the signed distance of point p from the plane (negative outside).
+// They are the clip space planes above taken back through a matrix: extracting them from the
+// projection matrix gives them in camera space, from a world-view-projection matrix in object space.
+// The sides are the screen edges (not the guard band), nothing past them is visible.
+enum {
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR, // only culls when far_plane_clipping is on
+    NUM_FRUSTUM_PLANES
+};
+
+typedef struct {
+    vec4_t vertices[MAX_NUM_POLY_VERTICES]; // clip space positions
+    tex2_t texcoords[MAX_NUM_POLY_VERTICES];
+    int num_vertices;
+} polygon_t;
+
+uint32_t screen_outcode(vec4_t projected_vertex, float viewport_width, float viewport_height);
+polygon_t polygon_from_triangle(vec4_t v0, vec4_t v1, vec4_t v2, tex2_t t0, tex2_t t1, tex2_t t2);
+void clip_polygon(polygon_t* polygon, uint32_t planes);
+vec4_t clip_to_screen(vec4_t clip_vertex, float viewport_width, float viewport_height);
+
+void extract_frustum_planes(const mat4_t* matrix, vec4_t planes[NUM_FRUSTUM_PLANES]);
+bool sphere_outside_frustum(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t center, float radius);
+bool box_outside_frustum(const vec4_t planes[NUM_FRUSTUM_PLANES], vec3_t box_min, vec3_t box_max);
+
+#endif
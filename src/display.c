@@ -12,6 +12,7 @@ float* z_buffer = NULL;
 SDL_Texture* color_buffer_texture = NULL;
 int window_width = 800; // int just for code simplicity according to pikuma
 int window_height = 600;
+scissor_rect_t scissor_rect = { 0, 0, 800, 600 };
 
 enum cull_method cull_method = CULL_BACKFACE; // could also be just enum cull_method cull_method;
 enum render_method render_method = RENDER_WIRE; // could also be just enum render_method render_method;
@@ -35,6 +36,7 @@ bool initialize_window(void)
 	SDL_GetCurrentDisplayMode(0, &display_mode);
 	window_width = display_mode.w;
 	window_height = display_mode.h;
+	reset_scissor_rect();
 
 	// Create an SDL Window
 	window = SDL_CreateWindow(
@@ -185,4 +187,20 @@ void destroy_window(void)
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Restrict triangle drawing to a rectangle, always kept inside the window
+///////////////////////////////////////////////////////////////////////////////
+void set_scissor_rect(int x, int y, int width, int height)
+{
+	scissor_rect.x_min = (x > 0) ? x : 0;
+	scissor_rect.y_min = (y > 0) ? y : 0;
+	scissor_rect.x_max = (x + width < window_width) ? x + width : window_width;
+	scissor_rect.y_max = (y + height < window_height) ? y + height : window_height;
+}
+
+void reset_scissor_rect(void)
+{
+	set_scissor_rect(0, 0, window_width, window_height);
+}
@@ -69,6 +69,20 @@ extern SDL_Texture* color_buffer_texture;
 extern int window_width; // int just for code simplicity according to pikuma
 extern int window_height; // could also be uint32_t etc
 
+// The rectangle of the color buffer (and z-buffer) the triangle routines may draw in,
+// from (x_min, y_min) included to (x_max, y_max) excluded.
+// Triangles get their rows and spans clamped to it once in the triangle setup,
+// so the per pixel code never has to check its coordinates.
+// Normally the whole window, but it can be narrowed to draw into part of it (e.g. one tile).
+typedef struct {
+	int x_min;
+	int y_min;
+	int x_max;
+	int y_max;
+} scissor_rect_t;
+
+extern scissor_rect_t scissor_rect;
+
 bool initialize_window(void);
 void draw_grid(void);
 void draw_pixel(int x, int y, uint32_t color);
@@ -78,6 +92,8 @@ void draw_rect(int x, int y, int width, int height, uint32_t color);
 void render_color_buffer(void);
 void clear_color_buffer(uint32_t color);
 void clear_z_buffer(void);
+void set_scissor_rect(int x, int y, int width, int height);
+void reset_scissor_rect(void);
 void destroy_window(void);
 
 #endif
\ No newline at end of file
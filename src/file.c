@@ -0,0 +1,259 @@
+// mmap and friends are POSIX, not part of C99, so ask for them explicitly
+// (has to come before any system header gets included)
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h> // for stderr
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>    // for SDL_ThreadID
+#include "file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Map the whole file in memory, so we can scan it like a plain char array
+// without copying it line by line into a buffer (like fgets does).
+// The OS pages the contents in on demand while we read through them.
+///////////////////////////////////////////////////////////////////////////////
+bool map_file(const char* filename, mapped_file_t* file)
+{
+    file->data = NULL;
+    file->size = 0;
+
+#ifdef _WIN32
+    file->file_handle = NULL;
+    file->mapping_handle = NULL;
+
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "Error opening file %s.\n", filename);
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    file->file_handle = file_handle;
+    file->size = (size_t)file_size.QuadPart;
+
+    // Mapping an empty file is an error on Windows, but an empty file is still a valid (empty) file
+    if (file->size == 0)
+        return true;
+
+    file->mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping_handle != NULL)
+        file->data = (const char*)MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening file %s.\n", filename);
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        fprintf(stderr, "Error reading file %s.\n", filename);
+        return false;
+    }
+    file->size = (size_t)file_stat.st_size;
+
+    // mmap with a length of 0 fails, but an empty file is still a valid (empty) file
+    if (file->size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+
+    if (data != MAP_FAILED)
+    {
+        // We always read front to back, so let the kernel read ahead aggressively
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        file->data = (const char*)data;
+    }
+#endif
+
+    if (file->data == NULL)
+    {
+        unmap_file(file);
+        fprintf(stderr, "Error mapping file %s in memory.\n", filename);
+        return false;
+    }
+    return true;
+}
+
+void unmap_file(mapped_file_t* file)
+{
+#ifdef _WIN32
+    if (file->data != NULL)
+        UnmapViewOfFile(file->data);
+    if (file->mapping_handle != NULL)
+        CloseHandle(file->mapping_handle);
+    if (file->file_handle != NULL)
+        CloseHandle(file->file_handle);
+    file->file_handle = NULL;
+    file->mapping_handle = NULL;
+#else
+    if (file->data != NULL)
+        munmap((void*)file->data, file->size);
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Size and last modification time of a file, without opening it.
+// Handy to tell if a file derived from another one (like a cache) is stale.
+// The time is as precise as the file system keeps it (100 ns on Windows, nanoseconds on POSIX),
+// whole seconds would miss a file written again within the same second.
+///////////////////////////////////////////////////////////////////////////////
+bool file_info(const char* filename, uint64_t* size, int64_t* modified_time)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes))
+        return false;
+    *size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    *modified_time = ((int64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat file_stat;
+    if (stat(filename, &file_stat) != 0)
+        return false;
+    *size = (uint64_t)file_stat.st_size;
+#ifdef __APPLE__
+    *modified_time = (int64_t)file_stat.st_mtimespec.tv_sec * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+    *modified_time = (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+// Without a word about it when it doesn't exist, unlike map_file
+bool file_exists(const char* filename)
+{
+#ifdef _WIN32
+    return GetFileAttributesA(filename) != INVALID_FILE_ATTRIBUTES;
+#else
+    struct stat file_stat;
+    return stat(filename, &file_stat) == 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// A name next to filename that no other thread or process uses at the same time
+// (filename.<process id>.<thread id>.tmp), to write a new version of filename
+// in full before replace_file puts it in place. Remember to free the returned string.
+///////////////////////////////////////////////////////////////////////////////
+char* temp_filename(const char* filename)
+{
+#ifdef _WIN32
+    unsigned long process_id = (unsigned long)GetCurrentProcessId();
+#else
+    unsigned long process_id = (unsigned long)getpid();
+#endif
+    unsigned long thread_id = (unsigned long)SDL_ThreadID();
+    size_t size = strlen(filename) + 2 * 21 + sizeof("...tmp");
+    char* temp = (char*)malloc(size);
+    if (temp != NULL)
+        snprintf(temp, size, "%s.%lu.%lu.tmp", filename, process_id, thread_id);
+    return temp;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Put source in the place of destination in one step: opening destination gives either
+// the old file or the new one, never a mix of both. On POSIX the old file lives on for
+// whoever still has it open or mapped, Windows refuses to replace a file that is in use.
+///////////////////////////////////////////////////////////////////////////////
+bool replace_file(const char* source, const char* destination)
+{
+#ifdef _WIN32
+    return MoveFileExA(source, destination, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(source, destination) == 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Absolute path of an existing file, with the "." and ".." (and on POSIX the symbolic links) resolved,
+// so every way of naming the same file gives the same string.
+// False if the file can't be found or the path doesn't fit in path_size bytes.
+///////////////////////////////////////////////////////////////////////////////
+bool canonical_path(const char* filename, char* path, size_t path_size)
+{
+#ifdef _WIN32
+    if (_fullpath(path, filename, path_size) == NULL)
+        return false;
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+#else
+    char* resolved = realpath(filename, NULL);
+    if (resolved == NULL)
+        return false;
+    size_t length = strlen(resolved);
+    bool fits = (length < path_size);
+    if (fits)
+        memcpy(path, resolved, length + 1);
+    free(resolved);
+    return fits;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// 64-bit hash of the contents of a file, to tell files that can't hold the same data apart
+// without keeping either around. It's FNV-1a taking 8 bytes at a time instead of one
+// (and the high bits folded back down after every multiply, which only carries bits upwards),
+// so it runs at about the speed the file can be read.
+///////////////////////////////////////////////////////////////////////////////
+bool file_hash(const char* filename, uint64_t* hash)
+{
+    mapped_file_t file;
+    if (!map_file(filename, &file))
+        return false;
+
+    uint64_t value = 14695981039346656037ULL;
+    size_t num_words = file.size / sizeof(uint64_t);
+    for (size_t i = 0; i < num_words; i++)
+    {
+        uint64_t word;
+        memcpy(&word, file.data + i * sizeof(uint64_t), sizeof(word)); // the mapping is aligned, this is a plain load
+        value = (value ^ word) * 1099511628211ULL;
+        value ^= value >> 29;
+    }
+    for (size_t i = num_words * sizeof(uint64_t); i < file.size; i++)
+        value = (value ^ (uint8_t)file.data[i]) * 1099511628211ULL;
+    unmap_file(&file);
+    *hash = value;
+    return true;
+}
+
+// Both files hold exactly the same bytes
+bool same_file_contents(const char* filename, const char* other_filename)
+{
+    mapped_file_t file, other_file;
+    if (!map_file(filename, &file))
+        return false;
+    if (!map_file(other_filename, &other_file))
+    {
+        unmap_file(&file);
+        return false;
+    }
+
+    bool same = (file.size == other_file.size) && (file.size == 0 || memcmp(file.data, other_file.data, file.size) == 0);
+    unmap_file(&file);
+    unmap_file(&other_file);
+    return same;
+}
@@ -0,0 +1,29 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// A read-only view of a whole file mapped into memory.
+// Note that the data is NOT null terminated, always use size to find the end.
+typedef struct {
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    void* file_handle;    // HANDLE returned by CreateFile
+    void* mapping_handle; // HANDLE returned by CreateFileMapping
+#endif
+} mapped_file_t;
+
+bool map_file(const char* filename, mapped_file_t* file);
+void unmap_file(mapped_file_t* file);
+bool file_info(const char* filename, uint64_t* size, int64_t* modified_time);
+bool file_exists(const char* filename);
+char* temp_filename(const char* filename);
+bool replace_file(const char* source, const char* destination);
+bool canonical_path(const char* filename, char* path, size_t path_size);
+bool file_hash(const char* filename, uint64_t* hash);
+bool same_file_contents(const char* filename, const char* other_filename);
+
+#endif
@@ -0,0 +1,163 @@
+#include <string.h>
+#include <math.h>
+#include "array.h"
+#include "impostor.h"
+
+impostor_cache_t impostor_cache;
+
+void impostor_cache_init(impostor_cache_t* cache, arena_t* arena)
+{
+    memset(cache, 0, sizeof(impostor_cache_t));
+    uint32_t* pixels = (uint32_t*)arena_alloc(arena, sizeof(uint32_t) * IMPOSTOR_SIZE * IMPOSTOR_SIZE * IMPOSTOR_CACHE_SIZE);
+    cache->z_buffer = (float*)arena_alloc(arena, sizeof(float) * IMPOSTOR_SIZE * IMPOSTOR_SIZE);
+    for (int i = 0; i < IMPOSTOR_CACHE_SIZE; i++)
+    {
+        impostor_t* impostor = &cache->slots[i];
+        impostor->instance = -1;
+        impostor->last_used_frame = -1;
+        if (pixels == NULL || cache->z_buffer == NULL)
+            continue; // no texture, the slot can't be used
+        impostor->texture.pixels = &pixels[i * IMPOSTOR_SIZE * IMPOSTOR_SIZE];
+        impostor->texture.width = IMPOSTOR_SIZE;
+        impostor->texture.height = IMPOSTOR_SIZE;
+        impostor->texture.has_cutout = true;
+    }
+}
+
+void impostor_cache_begin_frame(impostor_cache_t* cache, const scene_t* scene)
+{
+    cache->frame++;
+    cache->num_renders = 0;
+
+    // Instances added since the last frame have no impostor yet
+    int num_slots = (int)array_length(cache->instance_slots);
+    int num_instances = scene_num_instances(scene);
+    if (num_instances > num_slots)
+    {
+        array_resize(cache->instance_slots, num_instances);
+        for (int i = num_slots; i < num_instances; i++)
+            cache->instance_slots[i] = -1;
+    }
+}
+
+// A free slot, or else the one least recently used before this frame (NULL if they were all used this frame)
+static impostor_t* take_slot(impostor_cache_t* cache, int instance_index)
+{
+    int oldest = -1;
+    for (int i = 0; i < IMPOSTOR_CACHE_SIZE; i++)
+    {
+        const impostor_t* impostor = &cache->slots[i];
+        if (impostor->texture.pixels == NULL || impostor->last_used_frame == cache->frame)
+            continue;
+        if (oldest < 0 || impostor->last_used_frame < cache->slots[oldest].last_used_frame)
+            oldest = i;
+        if (impostor->instance < 0)
+            break;
+    }
+    if (oldest < 0)
+        return NULL;
+
+    impostor_t* impostor = &cache->slots[oldest];
+    if (impostor->instance >= 0)
+        cache->instance_slots[impostor->instance] = -1;
+    impostor->instance = instance_index;
+    impostor->is_drawn = false;
+    cache->instance_slots[instance_index] = oldest;
+    return impostor;
+}
+
+impostor_t* impostor_cache_get(impostor_cache_t* cache, const scene_t* scene, int instance_index,
+    vec3_t camera_position, bool is_textured, bool* needs_drawing)
+{
+    const mesh_instance_t* instance = &scene->instances[instance_index];
+    vec3_t view_direction = vec3_sub(instance->bounds_center, camera_position);
+    vec3_normalize(&view_direction);
+
+    int slot = cache->instance_slots[instance_index];
+    impostor_t* impostor = (slot >= 0) ? &cache->slots[slot] : NULL;
+    bool is_usable = (impostor != NULL && impostor->is_drawn && impostor->is_textured == is_textured);
+    bool is_current = is_usable &&
+        vec3_dot(view_direction, impostor->view_direction) >= cosf(IMPOSTOR_MAX_ANGLE) &&
+        memcmp(&impostor->world_matrix, &instance->transform.world_matrix, sizeof(mat4_t)) == 0;
+
+    *needs_drawing = false;
+    if (!is_current && cache->num_renders < IMPOSTOR_MAX_RENDERS_PER_FRAME)
+    {
+        if (impostor == NULL)
+            impostor = take_slot(cache, instance_index);
+        if (impostor == NULL)
+            return NULL;
+        impostor->is_textured = is_textured;
+        cache->num_renders++;
+        *needs_drawing = true;
+    }
+    else if (!is_current && !is_usable)
+        return NULL; // nothing to show until there is room to draw it
+
+    impostor->last_used_frame = cache->frame;
+    return impostor;
+}
+
+// Axes of the impostor picture in world space, the same mat4_look_at gives the camera
+// (the world up, unless the view is almost vertical)
+static void impostor_axes(vec3_t view_direction, vec3_t* right, vec3_t* up)
+{
+    vec3_t world_up = { 0, 1, 0 };
+    if (fabsf(view_direction.y) > 0.99f)
+    {
+        world_up.y = 0;
+        world_up.z = 1;
+    }
+    *right = vec3_cross(world_up, view_direction);
+    vec3_normalize(right);
+    *up = vec3_cross(view_direction, *right);
+}
+
+void impostor_camera(impostor_t* impostor, const mesh_instance_t* instance, vec3_t camera_position,
+    mat4_t* view_matrix, mat4_t* proj_matrix)
+{
+    vec3_t center = instance->bounds_center;
+    float radius = instance->bounds_radius;
+    vec3_t to_center = vec3_sub(center, camera_position);
+    float distance = vec3_length(to_center);
+    impostor->view_direction = vec3_div(to_center, distance);
+    impostor->world_matrix = instance->transform.world_matrix;
+    impostor->is_drawn = true;
+
+    // The field of view just fits the sphere: the cone from the camera touching it has a half angle
+    // of asin(radius / distance), its tangent is radius / sqrt(distance^2 - radius^2).
+    // The quad goes through the center of the sphere, where that cone is half_size wide.
+    // (Impostors are only used with the camera well outside of the sphere.)
+    float tangent = radius / sqrtf(distance * distance - radius * radius);
+    impostor->half_size = distance * tangent;
+
+    vec3_t right, up;
+    impostor_axes(impostor->view_direction, &right, &up);
+    *view_matrix = mat4_look_at(camera_position, center, up);
+    *proj_matrix = mat4_make_perspective(2.0f * atanf(tangent), 1.0f, fmaxf(distance - radius, 0.001f) * 0.5f, distance + radius);
+}
+
+void impostor_quad(const impostor_t* impostor, const mesh_instance_t* instance, vec3_t corners[4], tex2_t texcoords[4])
+{
+    vec3_t right, up;
+    impostor_axes(impostor->view_direction, &right, &up);
+    right = vec3_mul(right, impostor->half_size);
+    up = vec3_mul(up, impostor->half_size);
+
+    // The first row of the texture is the top of the picture (screen y points down)
+    vec3_t center = instance->bounds_center;
+    corners[0] = vec3_add(vec3_sub(center, right), up);
+    corners[1] = vec3_add(vec3_add(center, right), up);
+    corners[2] = vec3_sub(vec3_add(center, right), up);
+    corners[3] = vec3_sub(vec3_sub(center, right), up);
+    texcoords[0] = (tex2_t){ 0.0f, 0.0f };
+    texcoords[1] = (tex2_t){ 1.0f, 0.0f };
+    texcoords[2] = (tex2_t){ 1.0f, 1.0f };
+    texcoords[3] = (tex2_t){ 0.0f, 1.0f };
+}
+
+void impostor_cache_free(impostor_cache_t* cache)
+{
+    array_free(cache->instance_slots);
+    cache->instance_slots = NULL;
+}
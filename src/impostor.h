@@ -0,0 +1,72 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+#include "texture.h"
+#include "arena.h"
+#include "scene.h"
+
+// Impostors: an instance too small on screen for its triangles to matter is drawn once into a small
+// texture, as seen from the camera, and from then on as a single textured quad (2 triangles)
+// facing the direction it was drawn from, in the plane through the center of its bounding sphere.
+// The texture is transparent around the instance (it has cutouts, texels with a 0 alpha are never drawn).
+//
+// The picture only holds while the instance is seen from about the same direction: it gets drawn again
+// when the direction from the camera to the instance turned more than IMPOSTOR_MAX_ANGLE since,
+// or when the instance itself moved. At most IMPOSTOR_MAX_RENDERS_PER_FRAME get drawn again per frame,
+// the others keep their slightly outdated picture (or are drawn as meshes when they have none yet).
+#define IMPOSTOR_SIZE 64                  // width and height of an impostor texture, in texels
+#define IMPOSTOR_MAX_SCREEN_RADIUS 32.0f  // instances with a smaller bounding sphere on screen (in pixels) become impostors
+#define IMPOSTOR_MAX_ANGLE 0.05f          // radians (about 3 degrees)
+#define IMPOSTOR_MAX_RENDERS_PER_FRAME 64
+#define IMPOSTOR_CACHE_SIZE 512           // impostors kept at once (16 KB of texture each), the least recently used go first
+
+typedef struct {
+    texture_t texture;     // IMPOSTOR_SIZE x IMPOSTOR_SIZE
+    int instance;          // index of the instance in the scene, -1 for a free slot
+    vec3_t view_direction; // from the camera to the center of the instance when it was drawn (unit length)
+    float half_size;       // half the width of the quad, in world units
+    mat4_t world_matrix;   // of the instance when it was drawn
+    bool is_textured;      // drawn with the texture of the instance, or flat shaded
+    bool is_drawn;         // false until the texture holds a picture
+    int last_used_frame;
+} impostor_t;
+
+typedef struct {
+    impostor_t slots[IMPOSTOR_CACHE_SIZE];
+    int* instance_slots;   // slot of every instance of the scene, -1 if it has none (array.h array)
+    float* z_buffer;       // IMPOSTOR_SIZE x IMPOSTOR_SIZE, to draw the impostors with
+    int frame;
+    int num_renders;       // impostors drawn this frame
+} impostor_cache_t;
+
+extern impostor_cache_t impostor_cache;
+
+// The textures and z-buffer come from arena
+void impostor_cache_init(impostor_cache_t* cache, arena_t* arena);
+
+// Call once per frame, before asking for impostors
+void impostor_cache_begin_frame(impostor_cache_t* cache, const scene_t* scene);
+
+// The impostor of the instance, with needs_drawing set when its texture must be drawn (again) now
+// from camera_position (see impostor_camera), or NULL when the instance should be drawn as a mesh this frame.
+impostor_t* impostor_cache_get(impostor_cache_t* cache, const scene_t* scene, int instance_index,
+    vec3_t camera_position, bool is_textured, bool* needs_drawing);
+
+// View and projection matrices to draw the instance into the impostor texture, looking at the center of
+// its bounding sphere from camera_position with the sphere just fitting in. Records the view direction and
+// world matrix in the impostor.
+void impostor_camera(impostor_t* impostor, const mesh_instance_t* instance, vec3_t camera_position,
+    mat4_t* view_matrix, mat4_t* proj_matrix);
+
+// World space corners of the quad of the impostor, with the texture coordinates of each
+// (top left, top right, bottom right, bottom left of the texture)
+void impostor_quad(const impostor_t* impostor, const mesh_instance_t* instance, vec3_t corners[4], tex2_t texcoords[4]);
+
+// Free the instance slots (the textures go away with the arena they came from)
+void impostor_cache_free(impostor_cache_t* cache);
+
+#endif
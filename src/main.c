@@ -1,9 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <float.h>
 #include <SDL.h>
-#include "upng.h"
-#include "array.h"
 #include "display.h"
 #include "vector.h"
 #include "mesh.h"
@@ -12,31 +13,91 @@
 #include "camera.h"
 #include "texture.h"
 #include "triangle.h"
-
-#define MAX_TRIANGLES_PER_MESH 10000
-// Array of triangles that should be rendered frame by frame
-triangle_t triangles_to_render[MAX_TRIANGLES_PER_MESH];
+#include "clipping.h"
+#include "arena.h"
+#include "scene.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "impostor.h"
+#include "streaming.h"
+#include "resource_cache.h"
+#include "scene_file.h"
+
+// Memory for everything allocated once and kept until the program quits,
+// like the color buffer and z-buffer (see arena.h). The meshes and textures have memory of their own,
+// shared by everything using them (see resource_cache.h).
+arena_t asset_arena;
+
+// Memory for everything update() computes for the current frame only,
+// reset at the start of every frame
+arena_t frame_arena;
+
+// Array of triangles that should be rendered frame by frame (in frame_arena)
+triangle_t* triangles_to_render = NULL;
 int num_triangles_to_render = 0;
 
+// The visible instances are processed by up to RENDER_MAX_THREADS workers, each taking a run of them.
+// Worker 0 is the main thread, the others have threads of their own, started once in setup() and woken every frame.
+// Waking a thread and waiting for it still costs about as much as a couple thousand faces take to process,
+// so smaller scenes get fewer workers, down to the main thread alone.
+#define RENDER_MAX_THREADS 16
+#define RENDER_MIN_FACES_PER_THREAD 4096
+
+// What one thread works on: its run of the visible instances, and the triangles it makes out of them.
+// Every worker has its own arena, so the threads never allocate from the same memory.
+typedef struct {
+	const int* instances; // indices in scene.instances
+	const int* lods;      // level of detail of each of them
+	int num_instances;
+	arena_t arena;        // reset at the start of every frame, like frame_arena
+	triangle_t* triangles;
+	int num_triangles;
+	int max_triangles;    // how many fit in triangles before it has to grow
+	bool has_work;        // set for the frame by the main thread, cleared by the worker thread once done
+} render_worker_t;
+
+render_worker_t render_workers[RENDER_MAX_THREADS];
+SDL_Thread* render_threads[RENDER_MAX_THREADS]; // of every worker but the first, NULL where it couldn't be created
+SDL_mutex* render_mutex;    // guards has_work of every worker, num_busy_workers and quit_render_threads
+SDL_cond* render_wake;      // signaled when the workers have work, or when it's time to quit
+SDL_cond* render_done;      // signaled when the last busy worker is done
+int num_busy_workers = 0;
+bool quit_render_threads = false;
+render_worker_t impostor_worker; // to draw the impostors with (see impostor.h)
+
+// The quads of the instances drawn as impostors this frame, 2 triangles each (in frame_arena)
+triangle_t* impostor_triangles = NULL;
+int num_impostor_triangles = 0;
+
 // Global variables for execution status and game loop
 
 // NOTE: pikuma suddenly has  world_matrix declared here in Coding the LookAt Function lesson
 mat4_t proj_matrix;
 mat4_t view_matrix;
 
+// The scene to load, the first command line argument if there is one
+const char* scene_filename = "./assets/f22.scene";
+
 bool is_running = false;
 int previous_frame_time = 0;
 float delta_time = 0;
 
+// With the render workers, further down
+static void start_render_threads(void);
+static void stop_render_threads(void);
+
 void setup(void)
 {
+	// Every mesh and texture is loaded through the resource cache
+	resource_cache_init(&resource_cache);
+
 	// Initialize render mode and triangle culling method
 	render_method = RENDER_WIRE;
 	cull_method = CULL_BACKFACE;
 
 	// allocate the required memory in bytes to hold the color buffer and z-buffer
-	color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
-	z_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
+	color_buffer = (uint32_t*)arena_alloc(&asset_arena, sizeof(uint32_t) * window_width * window_height);
+	z_buffer = (float*)arena_alloc(&asset_arena, sizeof(float) * window_width * window_height);
 	
 	// Creating an SDL texture that is used to display the color buffer
 	color_buffer_texture = SDL_CreateTexture(
@@ -80,13 +141,33 @@ void setup(void)
 	float znear = 0.1;
 	float zfar = 100.0;
 	proj_matrix = mat4_make_perspective(fov, aspect, znear, zfar);
+
+	// The threads of the render workers wait for their first frame
+	start_render_threads();
+
+	// Room for the pictures of the instances drawn as impostors (see impostor.h)
+	impostor_cache_init(&impostor_cache, &asset_arena);
 	
-	// Loads the cube values in the mesh data structure
-	//load_cube_mesh_data();
-	load_obj_file_data("./assets/f22.obj");
+	// Load the meshes and textures of the scene file, place their instances,
+	// and put the camera and the light where it says (see scene_file.h)
+	if (!load_scene_file(&scene, scene_filename, &asset_arena))
+		fprintf(stderr, "Error loading scene %s, starting with an empty one.\n", scene_filename);
+}
 
-	// Load the texture information from an external PNG file
-	load_png_texture_data("./assets/f22.png");
+// Which instance is right in front of the camera, and which is closest to it
+// (with the BVH and bounds of the last frame, the camera is only moved by update)
+static void print_picked_instance(void)
+{
+	float distance;
+	int picked = bvh_raycast(&scene_bvh, &scene, camera.position, camera.direction, FLT_MAX, &distance);
+	if (picked >= 0)
+		printf("Picked instance %d at distance %.2f\n", picked, distance);
+	else
+		printf("No instance in front of the camera\n");
+
+	int nearest = bvh_nearest(&scene_bvh, &scene, camera.position, FLT_MAX, &distance);
+	if (nearest >= 0)
+		printf("Nearest instance %d at distance %.2f\n", nearest, distance);
 }
 
 void process_input(void)
@@ -118,6 +199,12 @@ void process_input(void)
 				cull_method = CULL_BACKFACE;
 			if (event.key.keysym.sym == SDLK_x)
 				cull_method = CULL_NONE;
+			if (event.key.keysym.sym == SDLK_h)
+				print_triangle_stats(); // triangle sizes of the last frame
+			if (event.key.keysym.sym == SDLK_p)
+				print_picked_instance();
+			if (event.key.keysym.sym == SDLK_o)
+				occlusion_culling = !occlusion_culling;
 			if (event.key.keysym.sym == SDLK_UP)
                 camera.position.y += 3.0 * delta_time;
             if (event.key.keysym.sym == SDLK_DOWN)
@@ -138,6 +225,533 @@ void process_input(void)
 	}
 }
 
+// Save a projected triangle in the triangles of the worker
+static void add_triangle_to_render(render_worker_t* worker, triangle_t triangle)
+{
+	if (worker->num_triangles == worker->max_triangles)
+	{
+		// Double the array, in place when nothing else was allocated after it
+		int max_triangles = (worker->max_triangles > 0) ? worker->max_triangles * 2 : 1024;
+		triangle_t* triangles = (triangle_t*)arena_realloc(&worker->arena, worker->triangles,
+			sizeof(triangle_t) * worker->max_triangles, sizeof(triangle_t) * max_triangles);
+		if (triangles == NULL)
+			return;
+		worker->triangles = triangles;
+		worker->max_triangles = max_triangles;
+	}
+	worker->triangles[worker->num_triangles] = triangle;
+	worker->num_triangles++;
+}
+
+// Take one visible mesh instance, at level of detail lod, from its meshlets to the triangles of the worker.
+// Runs on any thread: it only reads the scene and the globals update() set, and writes to the worker.
+static void process_mesh_instance(render_worker_t* worker, const mesh_instance_t* instance, const mesh_lod_t* lod)
+{
+	const mesh_t* mesh = instance->mesh;
+	mat4_t world_view_matrix = instance->transform.world_view_matrix;
+	mat4_t world_view_proj_matrix = instance->transform.world_view_proj_matrix;
+
+	///////////////////////////////////////////////////////
+	// Meshlet culling
+	///////////////////////////////////////////////////////
+	// The camera is at the origin of camera space, so its position in object space
+	// is the translation (last column) of the inverse world-view matrix.
+	// Face normals go the other way, camera space normals are the transpose of that same inverse times the object space ones.
+	// Both are computed once here, so nothing below ever needs the vertices in camera space.
+	bool cull_in_object_space = instance->transform.has_world_view_inverse;
+	mat4_t object_matrix = instance->transform.world_view_inverse_matrix;
+	vec3_t camera_object_position = { object_matrix.m[0][3], object_matrix.m[1][3], object_matrix.m[2][3] };
+	mat4_t normal_matrix = world_view_matrix; // only right for rotations and uniform scales, but there's no inverse to do better
+	if (cull_in_object_space)
+	{
+		for (int row = 0; row < 3; row++)
+			for (int column = 0; column < 3; column++)
+				normal_matrix.m[row][column] = object_matrix.m[column][row];
+	}
+
+	// Whole clusters of faces of the chosen level (see meshlet.h) are rejected first, when their bounding sphere
+	// is outside of the view frustum, or when all their faces look away from the camera.
+	// The frustum planes come out of the world-view-projection matrix already in object space.
+	vec4_t frustum_planes[NUM_FRUSTUM_PLANES];
+	extract_frustum_planes(&world_view_proj_matrix, frustum_planes);
+
+	// The vertices of the surviving meshlets are marked per batch of the vertex stream,
+	// so only the batches somebody is going to look at get projected
+	int num_batches = mesh->vertex_stream.padded_count / VERTEX_STREAM_BATCH;
+	int* visible_meshlets = (int*)arena_alloc(&worker->arena, sizeof(int) * lod->num_meshlets);
+	bool* batch_is_visible = (bool*)arena_alloc(&worker->arena, sizeof(bool) * num_batches);
+	if (visible_meshlets == NULL || batch_is_visible == NULL)
+		return;
+	memset(batch_is_visible, 0, sizeof(bool) * num_batches);
+
+	int num_visible_meshlets = 0;
+	for (int m = 0; m < lod->num_meshlets; m++)
+	{
+		const meshlet_t* meshlet = &lod->meshlets[m];
+		if (sphere_outside_frustum(frustum_planes, meshlet->center, meshlet->radius))
+			continue;
+		if (cull_method == CULL_BACKFACE && cull_in_object_space && meshlet_is_backfacing(meshlet, camera_object_position))
+			continue;
+
+		visible_meshlets[num_visible_meshlets++] = m;
+		for (int b = meshlet->first_vertex / VERTEX_STREAM_BATCH; b <= (meshlet->end_vertex - 1) / VERTEX_STREAM_BATCH; b++)
+			batch_is_visible[b] = true;
+	}
+
+	///////////////////////////////////////////////////////
+	// Vertex processing
+	///////////////////////////////////////////////////////
+	// Every vertex is shared by several faces (about 6 on a closed mesh),
+	// so we transform and project each mesh vertex only once per frame,
+	// and the faces below just pick their 3 vertices from this array by index
+	//
+	// The positions are read from the structure of arrays copy of the vertices (see vertex_stream.h)
+	// and go through a batch kernel, 8 vertices at a time with AVX2, that does the whole
+	// matrix multiply, perspective divide and viewport mapping in a single pass.
+	// The array must hold the padded vertex count, the kernels always write full batches.
+	// Only the runs of visible batches get projected, the rest of the array stays garbage.
+	vec4_t* projected_vertices = (vec4_t*)arena_alloc(&worker->arena, sizeof(vec4_t) * mesh->vertex_stream.padded_count);
+	if (projected_vertices == NULL)
+		return;
+
+	// Project the vertices straight from object space, and map them to the screen
+	// NOTE: the viewport mapping inverts the y values to account for flipped screen y coordinate.
+	// Indeed needed on Linux to match output with Gustavo's,
+	// but there is a possibility it's not needed on Windows
+	// (my cube texture was flipped vertically, and rotations opposite from the videos there)
+	for (int b = 0; b < num_batches; b++)
+	{
+		if (!batch_is_visible[b])
+			continue;
+
+		int end_batch = b + 1;
+		while (end_batch < num_batches && batch_is_visible[end_batch])
+			end_batch++;
+		project_vertex_stream_range(&mesh->vertex_stream, &world_view_proj_matrix, window_width, window_height,
+			b * VERTEX_STREAM_BATCH, (end_batch - b) * VERTEX_STREAM_BATCH, projected_vertices);
+		b = end_batch;
+	}
+
+	///////////////////////////////////////////////////////
+	// Primitive assembly
+	///////////////////////////////////////////////////////
+	// Loop all	triangle faces of the visible meshlets
+	for (int m = 0; m < num_visible_meshlets; m++)
+	{
+		const meshlet_t* meshlet = &lod->meshlets[visible_meshlets[m]];
+		for (int i = meshlet->first_face; i < meshlet->first_face + meshlet->num_faces; i++)
+		{
+			uint32_t* face_indices = &mesh->indices[i * 3]; // the 3 vertex indices of the current mesh face
+
+			// Plane of the face (precomputed at load time, see build_face_planes in mesh.c)
+			// Triangle ACB in clocwise order (CW), normal from the cross product AB x AC
+			vec4_t face_plane = mesh->face_planes[i];
+			vec3_t face_normal = { face_plane.x, face_plane.y, face_plane.z };
+
+			// Backface culling test to see if the current face should be projected,
+			// before fetching any of its vertices
+			if (cull_method == CULL_BACKFACE && cull_in_object_space)
+			{
+				// Signed distance of the camera from the face plane:
+				// how aligned the camera ray (from a point of the face to the camera) is with the face normal
+				float dot_normal_camera = vec3_dot(face_normal, camera_object_position) + face_plane.w;
+
+				// Bypass the triangles that are looking away from the camera
+				if (dot_normal_camera < 0)
+				{
+					continue;
+				}
+
+				// NOTE : Some small observations after messing around with the 
+				// if statement above and cross product result.
+				// 
+				// in case you invert the if above to (dot_normal_camera > 0)
+				// then you can "look inside" the meshes, pretty much like when normals
+				// are inverted in an engine like Unreal.
+				// In that case changing the cross product arguments order, corrects back that issue
+				// 
+				// So this indeed showcases that order indeed matters for cross product,
+				// as it is then used in dot product operation to determine face-camera alignment.
+				// 
+				// One more way to "invert" the normals is to multiply cross product * -1.0
+				// achieving the same effect of "looking inside" the meshes.
+				// In that case the if statement above has to be inverted (dot_normal_camera > 0)
+				// so that the rendering is correct again.
+			}
+
+			// The vertices of the face were already projected in the vertex processing loop
+			vec4_t projected_points[3] = {
+				projected_vertices[face_indices[0]],
+				projected_vertices[face_indices[1]],
+				projected_vertices[face_indices[2]]
+			};
+
+			// Frustum culling and clipping test (see clipping.h)
+			// If all 3 vertices are outside of the same plane, or the same screen edge, nothing of the triangle can be visible
+			uint32_t outcodes[3] = {
+				screen_outcode(projected_points[0], window_width, window_height),
+				screen_outcode(projected_points[1], window_width, window_height),
+				screen_outcode(projected_points[2], window_width, window_height)
+			};
+			if (outcodes[0] & outcodes[1] & outcodes[2])
+			{
+				continue;
+			}
+
+			// Fallback when the camera can't be brought to object space: cull by the winding of the projected triangle.
+			// Front faces wind the same way on screen as in the mesh, which gives them a positive signed area
+			// (y points down on screen). Only valid when the triangle is entirely in front of the camera.
+			if (cull_method == CULL_BACKFACE && !cull_in_object_space &&
+				projected_points[0].w > 0 && projected_points[1].w > 0 && projected_points[2].w > 0)
+			{
+				float signed_area =
+					(projected_points[1].x - projected_points[0].x) * (projected_points[2].y - projected_points[0].y) -
+					(projected_points[1].y - projected_points[0].y) * (projected_points[2].x - projected_points[0].x);
+				if (signed_area < 0)
+				{
+					continue;
+				}
+			}
+
+			// Face normal in camera space (where the light is), for the shading below
+			vec4_t face_direction = { face_normal.x, face_normal.y, face_normal.z, 0 }; // w = 0, directions don't translate
+			vec3_t normal = vec3_from_vec4(mat4_mul_vec4(normal_matrix, face_direction));
+			vec3_normalize(&normal);
+		
+			// Calculate the shade intensity based on how aligned is the face normal and the inverse of the light ray
+			// Notes: we need the dot with the inverse of the light ray,
+			// dot product is just a float so a simple minus (-) symbol can be used
+			// Alternatively we could flip light.direction inside light.c 
+			// (currently is 1 on .z but we could change it to -1 to achieve the same effect).
+			// However Pikuma wanted to keep the light direction the same (going into the screen -> towards the model)
+			// so it more correctly alligns with the real world, on how the light ray would behave.
+			float light_intensity_factor = -vec3_dot(normal, light.direction);
+
+			// Calculate the triangle color based on light angle
+			uint32_t triangle_color = light_apply_intensity(instance->color, light_intensity_factor);
+		
+			// TODO: try to implement smooth (Gouraud) shading in the future
+			// we can read vertex normals needed for smooth shading from .obj file (lines starting with vn)
+			// we can modify the draw_filled_triangle and fill_flat_* functions
+			// to call draw_line by interpolating the color accordingly
+		
+			// Planes the triangle actually crosses. Most triangles only poke out of the screen
+			// but stay inside the guard band, and get drawn without clipping
+			uint32_t clip_planes = (outcodes[0] | outcodes[1] | outcodes[2]) & CLIP_PLANES;
+			if (clip_planes == 0)
+			{
+				triangle_t projected_triangle = {
+					.points = {
+						{ projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w },
+						{ projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w },
+						{ projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w },
+					},
+						.texcoords = {
+							{ mesh->texcoords[face_indices[0]].u, mesh->texcoords[face_indices[0]].v },
+							{ mesh->texcoords[face_indices[1]].u, mesh->texcoords[face_indices[1]].v },
+							{ mesh->texcoords[face_indices[2]].u, mesh->texcoords[face_indices[2]].v }
+						},
+						.color = triangle_color,
+						.texture = instance->texture
+				};
+
+				// Save the projected triangle in the array of triangles to render
+				add_triangle_to_render(worker, projected_triangle);
+				continue;
+			}
+
+			// The screen coordinates of a vertex behind the camera tell nothing about the guard band,
+			// so once the near plane gets clipped, check the guard band edges as well
+			if (clip_planes & CLIP_NEAR)
+			{
+				clip_planes |= CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP;
+			}
+
+			// Clipping happens before the perspective divide, so go back to the clip space vertices
+			// (computed again just for the few triangles that need it)
+			polygon_t polygon = polygon_from_triangle(
+				mat4_mul_vec4(world_view_proj_matrix, vec4_from_vec3(mesh->vertices[face_indices[0]])),
+				mat4_mul_vec4(world_view_proj_matrix, vec4_from_vec3(mesh->vertices[face_indices[1]])),
+				mat4_mul_vec4(world_view_proj_matrix, vec4_from_vec3(mesh->vertices[face_indices[2]])),
+				mesh->texcoords[face_indices[0]],
+				mesh->texcoords[face_indices[1]],
+				mesh->texcoords[face_indices[2]]
+			);
+			clip_polygon(&polygon, clip_planes);
+
+			// Break the clipped polygon back into triangles, as a fan around its first vertex
+			for (int k = 1; k + 1 < polygon.num_vertices; k++)
+			{
+				triangle_t clipped_triangle = {
+					.points = {
+						clip_to_screen(polygon.vertices[0], window_width, window_height),
+						clip_to_screen(polygon.vertices[k], window_width, window_height),
+						clip_to_screen(polygon.vertices[k + 1], window_width, window_height)
+					},
+					.texcoords = { polygon.texcoords[0], polygon.texcoords[k], polygon.texcoords[k + 1] },
+					.color = triangle_color,
+					.texture = instance->texture
+				};
+				add_triangle_to_render(worker, clipped_triangle);
+			}
+		}
+	}
+}
+
+static void process_worker_instances(render_worker_t* worker)
+{
+	for (int i = 0; i < worker->num_instances; i++)
+	{
+		const mesh_instance_t* instance = &scene.instances[worker->instances[i]];
+		process_mesh_instance(worker, instance, &instance->mesh->lods[worker->lods[i]]);
+	}
+}
+
+static int SDLCALL render_thread(void* data)
+{
+	render_worker_t* worker = (render_worker_t*)data;
+	SDL_LockMutex(render_mutex);
+	while (!quit_render_threads)
+	{
+		if (!worker->has_work)
+		{
+			SDL_CondWait(render_wake, render_mutex);
+			continue;
+		}
+
+		SDL_UnlockMutex(render_mutex);
+		process_worker_instances(worker);
+		SDL_LockMutex(render_mutex);
+		worker->has_work = false;
+		if (--num_busy_workers == 0)
+			SDL_CondSignal(render_done);
+	}
+	SDL_UnlockMutex(render_mutex);
+	return 0;
+}
+
+// One thread per worker but the first, up to the number of cores.
+// Without them (if they can't be created) the main thread does the work of every worker.
+static void start_render_threads(void)
+{
+	render_mutex = SDL_CreateMutex();
+	render_wake = SDL_CreateCond();
+	render_done = SDL_CreateCond();
+	if (render_mutex == NULL || render_wake == NULL || render_done == NULL)
+	{
+		fprintf(stderr, "Error creating the render threads: %s\n", SDL_GetError());
+		return;
+	}
+
+	int num_threads = SDL_GetCPUCount();
+	if (num_threads > RENDER_MAX_THREADS) num_threads = RENDER_MAX_THREADS;
+	for (int w = 1; w < num_threads; w++)
+		render_threads[w] = SDL_CreateThread(render_thread, "render_worker", &render_workers[w]);
+}
+
+static void stop_render_threads(void)
+{
+	if (render_mutex != NULL)
+	{
+		SDL_LockMutex(render_mutex);
+		quit_render_threads = true;
+		SDL_CondBroadcast(render_wake);
+		SDL_UnlockMutex(render_mutex);
+	}
+	for (int w = 0; w < RENDER_MAX_THREADS; w++)
+	{
+		if (render_threads[w] != NULL)
+			SDL_WaitThread(render_threads[w], NULL);
+		render_threads[w] = NULL;
+	}
+
+	SDL_DestroyCond(render_done);
+	SDL_DestroyCond(render_wake);
+	SDL_DestroyMutex(render_mutex);
+	render_done = NULL;
+	render_wake = NULL;
+	render_mutex = NULL;
+}
+
+// Instances of the same mesh next to each other, so a worker goes through all the copies of a mesh
+// while its face planes, meshlets and vertex stream are still in the cache
+static int compare_instances_by_mesh(const void* a, const void* b)
+{
+	const mesh_instance_t* instance_a = &scene.instances[*(const int*)a];
+	const mesh_instance_t* instance_b = &scene.instances[*(const int*)b];
+	if (instance_a->mesh != instance_b->mesh)
+		return ((uintptr_t)instance_a->mesh < (uintptr_t)instance_b->mesh) ? -1 : 1;
+	return *(const int*)a - *(const int*)b;
+}
+
+// Process the visible instances, split in runs of about the same number of faces between the workers,
+// each in its own thread (the first one in the calling thread, like the chunks of obj.c),
+// wait for all of them, then gather their triangles in triangles_to_render, in the order of the instances
+static void process_visible_instances(const int* visible_instances, const int* instance_lods, int num_visible_instances, int num_visible_faces)
+{
+	int num_workers = num_visible_faces / RENDER_MIN_FACES_PER_THREAD;
+	int num_cores = SDL_GetCPUCount();
+	if (num_workers > num_cores) num_workers = num_cores;
+	if (num_workers > RENDER_MAX_THREADS) num_workers = RENDER_MAX_THREADS;
+	if (num_workers < 1) num_workers = 1;
+
+	int first_instance = 0;
+	int faces_before = 0;
+	for (int w = 0; w < num_workers; w++)
+	{
+		// The run ends where the faces so far reach this worker's share of the total
+		int end_faces = (int)((long long)num_visible_faces * (w + 1) / num_workers);
+		int end_instance = first_instance;
+		int worker_faces = 0;
+		while (end_instance < num_visible_instances && (faces_before + worker_faces < end_faces || w == num_workers - 1))
+		{
+			worker_faces += scene.instances[visible_instances[end_instance]].mesh->lods[instance_lods[end_instance]].num_faces;
+			end_instance++;
+		}
+
+		render_worker_t* worker = &render_workers[w];
+		arena_reset(&worker->arena);
+		worker->instances = &visible_instances[first_instance];
+		worker->lods = &instance_lods[first_instance];
+		worker->num_instances = end_instance - first_instance;
+		worker->num_triangles = 0;
+		// Room for one triangle per face to start with (more are only needed when clipping splits a lot of them)
+		worker->triangles = (triangle_t*)arena_alloc(&worker->arena, sizeof(triangle_t) * worker_faces);
+		worker->max_triangles = (worker->triangles != NULL) ? worker_faces : 0;
+
+		first_instance = end_instance;
+		faces_before += worker_faces;
+	}
+
+	if (render_mutex != NULL)
+	{
+		SDL_LockMutex(render_mutex);
+		for (int w = 1; w < num_workers; w++)
+		{
+			if (render_threads[w] != NULL)
+			{
+				render_workers[w].has_work = true;
+				num_busy_workers++;
+			}
+		}
+		SDL_CondBroadcast(render_wake);
+		SDL_UnlockMutex(render_mutex);
+	}
+
+	process_worker_instances(&render_workers[0]);
+	for (int w = 1; w < num_workers; w++)
+	{
+		if (render_threads[w] == NULL)
+			process_worker_instances(&render_workers[w]); // no thread for it, do it ourselves
+	}
+
+	if (render_mutex != NULL)
+	{
+		SDL_LockMutex(render_mutex);
+		while (num_busy_workers > 0)
+			SDL_CondWait(render_done, render_mutex);
+		SDL_UnlockMutex(render_mutex);
+	}
+
+	int num_triangles = 0;
+	for (int w = 0; w < num_workers; w++)
+		num_triangles += render_workers[w].num_triangles;
+	triangles_to_render = (triangle_t*)arena_alloc(&frame_arena, sizeof(triangle_t) * num_triangles);
+	if (triangles_to_render == NULL)
+		return;
+	for (int w = 0; w < num_workers; w++)
+	{
+		memcpy(&triangles_to_render[num_triangles_to_render], render_workers[w].triangles, sizeof(triangle_t) * render_workers[w].num_triangles);
+		num_triangles_to_render += render_workers[w].num_triangles;
+	}
+}
+
+// Draw the filled or textured surface of a triangle (instances without a texture, or whose texture
+// isn't streamed in, get filled in the textured modes too)
+static void draw_triangle_surface(const triangle_t* triangle, bool is_textured)
+{
+	if (!is_textured || triangle->texture == NULL || triangle->texture->pixels == NULL)
+	{
+		draw_filled_triangle(
+			triangle->points[0].x, triangle->points[0].y, triangle->points[0].z, triangle->points[0].w, // vertex A
+			triangle->points[1].x, triangle->points[1].y, triangle->points[1].z, triangle->points[1].w, // vertex B
+			triangle->points[2].x, triangle->points[2].y, triangle->points[2].z, triangle->points[2].w, // vertex C
+			triangle->color
+		);
+	}
+	else
+	{
+		draw_textured_triangle(
+			triangle->points[0].x, triangle->points[0].y, triangle->points[0].z, triangle->points[0].w, triangle->texcoords[0].u, triangle->texcoords[0].v, // vertex A
+			triangle->points[1].x, triangle->points[1].y, triangle->points[1].z, triangle->points[1].w, triangle->texcoords[1].u, triangle->texcoords[1].v, // vertex B
+			triangle->points[2].x, triangle->points[2].y, triangle->points[2].z, triangle->points[2].w, triangle->texcoords[2].u, triangle->texcoords[2].v, // vertex C
+			triangle->texture
+		);
+	}
+}
+
+// Draw an instance into the texture of its impostor, as the camera sees it now (see impostor.h).
+// It goes through the same pipeline as on screen, with the color buffer, z-buffer
+// and window size pointing at the impostor for the time being.
+static void draw_impostor(impostor_t* impostor, const mesh_instance_t* instance, bool is_textured)
+{
+	mesh_instance_t impostor_instance = *instance;
+	mat4_t impostor_view_matrix, impostor_proj_matrix;
+	impostor_camera(impostor, instance, camera.position, &impostor_view_matrix, &impostor_proj_matrix);
+	transform_update(&impostor_instance.transform, impostor_view_matrix, impostor_proj_matrix);
+
+	uint32_t* screen_color_buffer = color_buffer;
+	float* screen_z_buffer = z_buffer;
+	int screen_width = window_width;
+	int screen_height = window_height;
+	color_buffer = impostor->texture.pixels;
+	z_buffer = impostor_cache.z_buffer;
+	window_width = IMPOSTOR_SIZE;
+	window_height = IMPOSTOR_SIZE;
+	reset_scissor_rect();
+	clear_color_buffer(0x00000000); // transparent where the instance isn't
+	clear_z_buffer();
+
+	// The instance fills the texture, its level of detail is the one for a sphere of that size
+	render_worker_t* worker = &impostor_worker;
+	arena_reset(&worker->arena);
+	worker->triangles = NULL;
+	worker->num_triangles = 0;
+	worker->max_triangles = 0;
+	process_mesh_instance(worker, &impostor_instance, &instance->mesh->lods[select_mesh_lod(instance->mesh, IMPOSTOR_SIZE / 2.0f)]);
+	for (int i = 0; i < worker->num_triangles; i++)
+		draw_triangle_surface(&worker->triangles[i], is_textured);
+
+	color_buffer = screen_color_buffer;
+	z_buffer = screen_z_buffer;
+	window_width = screen_width;
+	window_height = screen_height;
+	reset_scissor_rect();
+}
+
+// The 2 triangles of the quad of an impostor, false when it reaches behind the near plane (then the mesh is drawn instead)
+static bool add_impostor_triangles(const impostor_t* impostor, const mesh_instance_t* instance, const mat4_t* view_proj_matrix)
+{
+	vec3_t corners[4];
+	tex2_t texcoords[4];
+	impostor_quad(impostor, instance, corners, texcoords);
+
+	vec4_t points[4];
+	for (int i = 0; i < 4; i++)
+	{
+		vec4_t clip = mat4_mul_vec4(*view_proj_matrix, vec4_from_vec3(corners[i]));
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+			return false;
+		points[i] = clip_to_screen(clip, window_width, window_height);
+	}
+
+	triangle_t first = { .points = { points[0], points[1], points[2] }, .texcoords = { texcoords[0], texcoords[1], texcoords[2] }, .texture = &impostor->texture };
+	triangle_t second = { .points = { points[0], points[2], points[3] }, .texcoords = { texcoords[0], texcoords[2], texcoords[3] }, .texture = &impostor->texture };
+	impostor_triangles[num_impostor_triangles++] = first;
+	impostor_triangles[num_impostor_triangles++] = second;
+	return true;
+}
+
 void update(void)
 {
 	// old way of waiting for specific time consumed more CPU
@@ -175,14 +789,25 @@ void update(void)
 	
 	previous_frame_time = SDL_GetTicks();
 
-	// Initialize the counter of triangles to render for the current frame
+	// Forget everything computed for the previous frame
+	arena_reset(&frame_arena);
+	triangles_to_render = NULL;
 	num_triangles_to_render = 0;
+	impostor_triangles = NULL;
+	num_impostor_triangles = 0;
 
-	// Change the mesh scale/rotation values per animation frame
-	mesh.rotation.x += 0.0 * delta_time;
-	mesh.rotation.y += 0.0 * delta_time;
-	mesh.rotation.z += 0.0 * delta_time;
-	mesh.translation.z = 5.0;
+	// Change the scale/rotation values of the instances per animation frame
+	// (through the transform functions, so the cached matrices know when to be rebuilt)
+	int num_instances = scene_num_instances(&scene);
+	for (int i = 0; i < num_instances; i++)
+	{
+		transform_t* transform = &scene.instances[i].transform;
+		vec3_t rotation = transform->rotation;
+		rotation.x += 0.0 * delta_time;
+		rotation.y += 0.0 * delta_time;
+		rotation.z += 0.0 * delta_time;
+		transform_set_rotation(transform, rotation);
+	}
 		
 	// Initialize the target looking at the positive z-axis
 	vec3_t target = { 0, 0, 1};
@@ -195,218 +820,106 @@ void update(void)
 	
 	// Create the view matrix
 	view_matrix = mat4_look_at(camera.position, target, up_direction);
+
+	// Meshes and textures streamed in since the last frame show up now, and the ones too far away
+	// go when they take more than the memory budget (see streaming.h)
+	streaming_update(&streamer, &scene, camera.position, camera.direction);
 	
-	// Create a scale, rotation and translation matrix that will be used to multiply the mesh vertices
-	mat4_t scale_matrix = mat4_make_scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
-	mat4_t translation_matrix = mat4_make_translation(mesh.translation.x, mesh.translation.y, mesh.translation.z);
-	mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh.rotation.x);
-	mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh.rotation.y);
-	mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh.rotation.z);
-	
-	// Loop all	triangle faces of our mesh
-	int num_faces = array_length(mesh.faces);
-	for (int i = 0; i < num_faces; i++)
+	// Rebuild the world, world-view and world-view-projection matrices of the instances
+	// (only for the ones that moved, or for all of them when the camera moved), and the world bounds of the ones that moved
+	scene_update_transforms(&scene, view_matrix, proj_matrix);
+
+	///////////////////////////////////////////////////////
+	// Object culling and level of detail
+	///////////////////////////////////////////////////////
+	// The frustum planes extracted from the view-projection matrix are in world space, like the bounds of the instances.
+	// Instances entirely outside of one of the planes are dropped before any of their faces get looked at.
+	// The BVH follows the instances that moved, and drops whole groups of them at once (see bvh.h).
+	bvh_update(&scene_bvh, &scene);
+
+	mat4_t view_proj_matrix = mat4_mul_mat4(proj_matrix, view_matrix);
+	vec4_t frustum_planes[NUM_FRUSTUM_PLANES];
+	extract_frustum_planes(&view_proj_matrix, frustum_planes);
+
+	int* visible_instances = (int*)arena_alloc(&frame_arena, sizeof(int) * num_instances);
+	int* instance_lods = (int*)arena_alloc(&frame_arena, sizeof(int) * num_instances);
+	if (visible_instances == NULL || instance_lods == NULL)
+		return;
+
+	int num_visible_instances = bvh_cull_frustum(&scene_bvh, &scene, frustum_planes, visible_instances);
+
+	// Then the instances hidden behind the biggest ones on screen (see occlusion.h)
+	if (occlusion_culling)
+		num_visible_instances = cull_occluded_instances(&scene, visible_instances, num_visible_instances, &view_proj_matrix, &frame_arena);
+
+	qsort(visible_instances, num_visible_instances, sizeof(int), compare_instances_by_mesh);
+
+	// Small instances are drawn as impostors (see impostor.h), in the modes showing only surfaces
+	bool use_impostors = (render_method == RENDER_FILL_TRIANGLE || render_method == RENDER_TEXTURED);
+	bool is_textured = (render_method == RENDER_TEXTURED);
+	impostor_cache_begin_frame(&impostor_cache, &scene);
+	impostor_triangles = (triangle_t*)arena_alloc(&frame_arena, sizeof(triangle_t) * 2 * num_visible_instances);
+	if (impostor_triangles == NULL)
+		use_impostors = false;
+
+	int num_mesh_instances = 0;
+	int num_visible_faces = 0;
+	for (int i = 0; i < num_visible_instances; i++)
 	{
-		face_t mesh_face = mesh.faces[i]; // current mesh face
-
-		vec3_t face_vertices[3]; // store the points/vertices of the current triangle/face - each one of them is a vec3_t
-
-		// to actualy get the vec3_t vertices/points of current mesh face
-		// look in the mesh_vertices array using the indices stored in current mesh face
-
-		face_vertices[0] = mesh.vertices[mesh_face.a];
-		face_vertices[1] = mesh.vertices[mesh_face.b];
-		face_vertices[2] = mesh.vertices[mesh_face.c];
-
-		vec4_t transformed_vertices[3];
-
-		// Loop all three vertices of this current face/triangle and apply transformations
-		for (int j = 0; j < 3; j++)
+		const mesh_instance_t* instance = &scene.instances[visible_instances[i]];
+		if (instance->mesh->num_lods == 0)
+			continue; // streamed out, nothing to draw until it's back
+
+		// The radius of the bounding sphere on screen is its radius over its distance to the camera,
+		// times how many pixels a unit is at distance 1 (the vertical projection scale, and half the screen height).
+		// When the camera is inside the sphere the mesh is as big as it gets, full detail.
+		float distance = vec3_length(vec3_sub(instance->bounds_center, camera.position));
+		float screen_radius = 0.0f;
+		int lod = 0;
+		if (distance > instance->bounds_radius)
 		{
-			vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-
-			// Create a World Matrix combining scale, rotation and translation matrices
-			// TODO: world_matrix can be created outside the for loop
-			// so not all mat_mul functions get calculated each loop
-			// however for the sake of closely following the course let's keep it here
-			
-			// Order matters: First scale, then rotate, then translate
-			// [T]*[R]*[S]*v (expression must be read from right to left)
-			mat4_t world_matrix = mat4_identity();
-			world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-			world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-			
-			// Multiply the world matrix by the original vector
-			transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
-			
-			// Multiply the view matrix by the vector to transform the scene to camera space
-			transformed_vertex = mat4_mul_vec4(view_matrix, transformed_vertex);
-			
-			// Save transformed vertex in the array of transformed vertices
-			transformed_vertices[j] = transformed_vertex;
+			screen_radius = instance->bounds_radius / distance * proj_matrix.m[1][1] * window_height / 2.0f;
+			lod = select_mesh_lod(instance->mesh, screen_radius);
 		}
-		
-		// check moved below so we always calculate normal for use in light/shading
-		// just kept in place to showcase where it was before that lesson
-		// possible cleanup in the future
-		//if (cull_method == CULL_BACKFACE) 
-		
-		// Triangle ACB in clocwise order (CW)
-		vec3_t vector_a = vec3_from_vec4(transformed_vertices[0]); /*   A   */
-		vec3_t vector_b = vec3_from_vec4(transformed_vertices[1]); /*  / \  */
-		vec3_t vector_c = vec3_from_vec4(transformed_vertices[2]); /* C---B */
-
-		vec3_t vector_ab = vec3_sub(vector_b, vector_a);
-		vec3_t vector_ac = vec3_sub(vector_c, vector_a);
-		vec3_normalize(&vector_ab);
-		vec3_normalize(&vector_ac);
-
-		// Compute the face normal (using cross product to find perpendicular)
-		// Remember order of arguments matters for cross product direction
-		vec3_t normal = vec3_cross(vector_ab, vector_ac);
-
-		// Normalize the face normal vector
-		// normalized vector = vector with length 1 (hence .x , .y between 0.0 and 1.0)
-		// face normal vector = just a perpendicular vector to a face/triangle surface
-		vec3_normalize(&normal);
-
-		// Find the vector between a point in the triangle and the camera (note the camera is always at the origin now due to ViewMatrix translation)
-		vec3_t origin = {0, 0, 0};
-		vec3_t camera_ray = vec3_sub(origin, vector_a);
-
-		// Calculate how aligned the camera ray is with the face normal using dot product
-		float dot_normal_camera = vec3_dot(camera_ray, normal); // order does not matter for dot product, like it does in cross product
-
-		// Backface culling test to see if the current face should be projected
-		if (cull_method == CULL_BACKFACE)
+
+		// Only with the camera well outside of the sphere, so the quad is well in front of it
+		if (use_impostors && screen_radius > 0.0f && screen_radius < IMPOSTOR_MAX_SCREEN_RADIUS && distance > 2.0f * instance->bounds_radius)
 		{
-			// Bypass the triangles that are looking away from the camera
-			if (dot_normal_camera < 0)
+			bool needs_drawing;
+			impostor_t* impostor = impostor_cache_get(&impostor_cache, &scene, visible_instances[i], camera.position, is_textured, &needs_drawing);
+			if (impostor != NULL)
 			{
-				continue;
+				if (needs_drawing)
+					draw_impostor(impostor, instance, is_textured);
+				if (add_impostor_triangles(impostor, instance, &view_proj_matrix))
+					continue;
 			}
-
-			// NOTE : Some small observations after messing around with the 
-			// if statement above and cross product result.
-			// 
-			// in case you invert the if above to (dot_normal_camera > 0)
-			// then you can "look inside" the meshes, pretty much like when normals
-			// are inverted in an engine like Unreal.
-			// In that case changing the cross product arguments order, corrects back that issue
-			// 
-			// So this indeed showcases that order indeed matters for cross product,
-			// as it is then used in dot product operation to determine face-camera alignment.
-			// 
-			// One more way to "invert" the normals is to multiply cross product * -1.0
-			// achieving the same effect of "looking inside" the meshes.
-			// In that case the if statement above has to be inverted (dot_normal_camera > 0)
-			// so that the rendering is correct again.
 		}
 
-		vec4_t projected_points[3];
-
-		// Loop all three vertices (of a face/triangle) to perform the projection
-		for (int j = 0; j <3; j++) 
-		{
-			//project the current vertex
-			projected_points[j] = mat4_mul_vec4_project(proj_matrix, transformed_vertices[j]);
-
-			// Order of transformations still matters, so scale first and translate last
-			
-			// Scale into the view
-			projected_points[j].x *= (window_width / 2.0);
-			projected_points[j].y *= (window_height / 2.0);
-			
-			// NOTE: there is a possibility the following line is not needed on Windows
-			// I've noted that my cube texture is flipped vertically, as well as
-			// my rotations are exact opposite from what is showcased in the videos.
-			// I need to test on my Linux machine to make sure.
-			// Perhaps this is something driver/platform specific.
-			// Invert the y values to account for flipped screen y coordinate
-			
-			// Indeed needed on Linux to match output with Gustavo's,
-			// but remember to comment on Windows
-			// perhaps add an #ifdef Windows in the future
-			projected_points[j].y *= -1;
-			
-			// Translate the projected points to the middle of the screen
-			projected_points[j].x += (window_width / 2.0);
-			projected_points[j].y += (window_height / 2.0);
-		}
-		
-		// Calculate the shade intensity based on how aligned is the face normal and the inverse of the light ray
-		// Notes: we need the dot with the inverse of the light ray,
-		// dot product is just a float so a simple minus (-) symbol can be used
-		// Alternatively we could flip light.direction inside light.c 
-		// (currently is 1 on .z but we could change it to -1 to achieve the same effect).
-		// However Pikuma wanted to keep the light direction the same (going into the screen -> towards the model)
-		// so it more correctly alligns with the real world, on how the light ray would behave.
-		float light_intensity_factor = -vec3_dot(normal, light.direction);
-
-		// Calculate the triangle color based on light angle
-		uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
-		
-		// TODO: try to implement smooth (Gouraud) shading in the future
-		// we can read vertex normals needed for smooth shading from .obj file (lines starting with vn)
-		// we can modify the draw_filled_triangle and fill_flat_* functions
-		// to call draw_line by interpolating the color accordingly
-		
-		triangle_t projected_triangle = {
-			.points = {
-				{ projected_points[0].x, projected_points[0].y, projected_points[0].z, projected_points[0].w },
-				{ projected_points[1].x, projected_points[1].y, projected_points[1].z, projected_points[1].w },
-				{ projected_points[2].x, projected_points[2].y, projected_points[2].z, projected_points[2].w },
-			},
-				.texcoords = {
-					{ mesh_face.a_uv.u, mesh_face.a_uv.v },
-					{ mesh_face.b_uv.u, mesh_face.b_uv.v },
-					{ mesh_face.c_uv.u, mesh_face.c_uv.v }
-				},
-				.color = triangle_color,
-		};
-
-		// Save the projected triangle in the array of triangles to render
-		if (num_triangles_to_render < MAX_TRIANGLES_PER_MESH)
-		{
-			triangles_to_render[num_triangles_to_render] = projected_triangle;
-			num_triangles_to_render++;
-		}
+		visible_instances[num_mesh_instances] = visible_instances[i];
+		instance_lods[num_mesh_instances] = lod;
+		num_mesh_instances++;
+		num_visible_faces += instance->mesh->lods[lod].num_faces;
 	}
+
+	process_visible_instances(visible_instances, instance_lods, num_mesh_instances, num_visible_faces);
 }
 
 void render(void)
 {
 	draw_grid();
 
+	// The triangle size stats are per frame
+	reset_triangle_stats();
+
 	//Loop all projected triangles and render them
 	for (int i = 0; i < num_triangles_to_render; i++)
 	{
 		triangle_t triangle = triangles_to_render[i];
 
-		// Draw filled triangle
-		if (render_method == RENDER_FILL_TRIANGLE || render_method == RENDER_FILL_TRIANGLE_WIRE)
-		{
-			draw_filled_triangle(
-				triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, // vertex A
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, // vertex B
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, // vertex C
-                triangle.color
-			);
-		}
-
-		// Draw textured triangle
-		if (render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIRE)
-		{
-			draw_textured_triangle(
-				triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, triangle.texcoords[0].u, triangle.texcoords[0].v, // vertex A
-				triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, triangle.texcoords[1].u, triangle.texcoords[1].v, // vertex B
-				triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, triangle.texcoords[2].u, triangle.texcoords[2].v, // vertex C
-				mesh_texture
-			);
-		}
+		// Draw filled or textured triangle
+		if (render_method != RENDER_WIRE && render_method != RENDER_WIRE_VERTEX)
+			draw_triangle_surface(&triangle, render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIRE);
 
 		// Draw triangle wireframe
 		if (render_method == RENDER_WIRE || render_method == RENDER_WIRE_VERTEX || render_method == RENDER_FILL_TRIANGLE_WIRE || render_method == RENDER_TEXTURED_WIRE)
@@ -429,6 +942,10 @@ void render(void)
 		}
 	}
 
+	// The quads of the impostors are textured in every mode they are used in
+	for (int i = 0; i < num_impostor_triangles; i++)
+		draw_triangle_surface(&impostor_triangles[i], true);
+
 	render_color_buffer();
 	
 	clear_color_buffer(0xFF000000); // black (ABGR8888)
@@ -440,15 +957,24 @@ void render(void)
 // Free the memory that was dynamically allocated by the program
 void free_resources(void)
 {
-	free(color_buffer);
-	free(z_buffer);
-	upng_free(png_texture);
-	array_free(mesh.faces);
-	array_free(mesh.vertices);
+	stop_render_threads();
+	for (int w = 0; w < RENDER_MAX_THREADS; w++)
+		arena_free(&render_workers[w].arena);
+	arena_free(&impostor_worker.arena);
+	impostor_cache_free(&impostor_cache);
+	streaming_free(&streamer);
+	bvh_free(&scene_bvh);
+	scene_free(&scene);
+	resource_cache_free(&resource_cache);
+	arena_free(&asset_arena); // color buffer, z-buffer and the impostor textures, all at once
+	arena_free(&frame_arena);
 }
 
 int main(int argc, char* argv[])
 {
+	if (argc > 1)
+		scene_filename = argv[1];
+
 	is_running = initialize_window();
 
 	setup();
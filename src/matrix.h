@@ -1,6 +1,7 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <stdbool.h>
 #include "vector.h"
 
 typedef struct {
@@ -18,5 +19,6 @@ vec4_t mat4_mul_vec4(mat4_t m, vec4_t v);
 mat4_t mat4_mul_mat4(mat4_t a, mat4_t b);
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v);
 mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up);
+bool mat4_inverse(mat4_t m, mat4_t* result);
 
 #endif
\ No newline at end of file
@@ -1,19 +1,18 @@
 #include <stdio.h> // for NULL
-#include <string.h>
+#include <stdlib.h> // for malloc
+#include <string.h> // for memcpy
+#include <stdbool.h>
+#include <math.h>
 #include "array.h"
 #include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj.h"
 
 // Definition and initialization of 
 // extern variables declared in mesh.h
 
-mesh_t mesh = {
-    .vertices = NULL,
-    .faces = NULL,
-    .rotation = { 0, 0, 0},
-    .scale = { 1.0, 1.0, 1.0},
-    .translation = { 0, 0, 0}
-};
-
 vec3_t cube_vertices[N_CUBE_VERTICES] = {
 	{.x = -1, .y = -1, .z = -1 }, // 1
 	{.x = -1, .y = 1, .z = -1 }, // 2
@@ -25,43 +24,261 @@ vec3_t cube_vertices[N_CUBE_VERTICES] = {
 	{.x = -1, .y = -1, .z = 1 }  // 8
 };
 
+tex2_t cube_texcoords[N_CUBE_TEXCOORDS] = {
+    { 0, 1 },
+    { 0, 0 },
+    { 1, 0 },
+    { 1, 1 }
+};
+
+// Unlike .obj files, these indices are 0-based (vertex // 1 above is index 0)
 face_t cube_faces[N_CUBE_FACES] = {
     // front
-    { .a = 1, .b = 2, .c = 3, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 1, .b = 3, .c = 4, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
+    { .a = 0, .b = 1, .c = 2, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 0, .b = 2, .c = 3, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
     // right
-    { .a = 4, .b = 3, .c = 5, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 4, .b = 5, .c = 6, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
+    { .a = 3, .b = 2, .c = 4, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 3, .b = 4, .c = 5, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
     // back
-    { .a = 6, .b = 5, .c = 7, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 6, .b = 7, .c = 8, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
+    { .a = 5, .b = 4, .c = 6, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 5, .b = 6, .c = 7, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
     // left
-    { .a = 8, .b = 7, .c = 2, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 8, .b = 2, .c = 1, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
+    { .a = 7, .b = 6, .c = 1, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 7, .b = 1, .c = 0, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
     // top
-    { .a = 2, .b = 7, .c = 5, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 2, .b = 5, .c = 3, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF },
+    { .a = 1, .b = 6, .c = 4, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 1, .b = 4, .c = 2, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
     // bottom
-    { .a = 6, .b = 8, .c = 1, .a_uv = { 0, 1 }, .b_uv = { 0, 0 }, .c_uv = { 1, 0 }, .color = 0xFFFFFFFF },
-    { .a = 6, .b = 1, .c = 4, .a_uv = { 0, 1 }, .b_uv = { 1, 0 }, .c_uv = { 1, 1 }, .color = 0xFFFFFFFF }
+    { .a = 5, .b = 7, .c = 0, .a_uv = 0, .b_uv = 1, .c_uv = 2, .a_normal = -1, .b_normal = -1, .c_normal = -1 },
+    { .a = 5, .b = 0, .c = 3, .a_uv = 0, .b_uv = 2, .c_uv = 3, .a_normal = -1, .b_normal = -1, .c_normal = -1 }
 };
 
 
 // TODO: Create implementation for mesh.h functions
 
-void load_cube_mesh_data(void)
+// Hash of a v/vt/vn index combination, for the hash map that welds identical corners
+static uint32_t hash_corner(obj_index_t corner)
+{
+    uint32_t hash = (uint32_t)corner.v * 0x9E3779B1u;
+    hash ^= (uint32_t)corner.vt * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+    hash ^= (uint32_t)corner.vn * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+    return hash ^ (hash >> 16);
+}
+
+static bool same_corner(obj_index_t a, obj_index_t b)
+{
+    return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build the indexed vertex buffer of the mesh from the face corners of an obj.
+// Every unique v/vt/vn combination becomes one vertex (found through an
+// open addressing hash map), and every corner becomes an index to it.
+///////////////////////////////////////////////////////////////////////////////
+static void build_indexed_mesh(obj_t* obj, mesh_t* mesh)
+{
+    int num_corners = array_length(obj->indices);
+
+    // Power of two size, at most half full so probe chains stay short
+    uint32_t table_size = 16;
+    while (table_size < (uint32_t)num_corners * 2)
+        table_size *= 2;
+    uint32_t table_mask = table_size - 1;
+
+    int* table = (int*)malloc(sizeof(int) * table_size); // vertex index of each slot, -1 for empty slots
+    for (uint32_t i = 0; i < table_size; i++)
+        table[i] = -1;
+
+    // The v/vt/vn combination of every vertex, there can't be more of them than corners
+    obj_index_t* unique_corners = NULL;
+    array_reserve(unique_corners, num_corners);
+    mesh->indices = array_hold(NULL, num_corners, sizeof(uint32_t));
+
+    for (int i = 0; i < num_corners; i++)
+    {
+        obj_index_t corner = obj->indices[i];
+        uint32_t slot = hash_corner(corner) & table_mask;
+        while (table[slot] != -1 && !same_corner(unique_corners[table[slot]], corner))
+            slot = (slot + 1) & table_mask;
+
+        if (table[slot] == -1)
+        {
+            // First time we see this combination, add a new vertex
+            table[slot] = array_length(unique_corners);
+            array_push(unique_corners, corner);
+        }
+        mesh->indices[i] = (uint32_t)table[slot];
+    }
+    free(table);
+
+    // Now that we know how many vertices there are, gather their attributes
+    int num_vertices = array_length(unique_corners);
+    bool has_normals = array_length(obj->normals) > 0;
+    mesh->vertices = array_hold(NULL, num_vertices, sizeof(vec3_t));
+    mesh->texcoords = array_hold(NULL, num_vertices, sizeof(tex2_t));
+    mesh->normals = has_normals ? array_hold(NULL, num_vertices, sizeof(vec3_t)) : NULL;
+
+    for (int i = 0; i < num_vertices; i++)
+    {
+        obj_index_t corner = unique_corners[i];
+        tex2_t zero_texcoord = { 0, 0 }; // for corners without UVs (e.g. teapot.obj and bunny.obj)
+        vec3_t zero_normal = { 0, 0, 0 };
+
+        mesh->vertices[i] = obj->vertices[corner.v];
+        mesh->texcoords[i] = (corner.vt >= 0) ? obj->texcoords[corner.vt] : zero_texcoord;
+        if (has_normals)
+            mesh->normals[i] = (corner.vn >= 0) ? obj->normals[corner.vn] : zero_normal;
+    }
+    array_free(unique_corners);
+
+    mesh->num_vertices = num_vertices;
+    mesh->num_faces = num_corners / 3;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Plane of every face in object space, for the backface culling in update().
+// Instead of building each face normal from its transformed vertices every frame,
+// the camera gets transformed into object space once per frame,
+// and one dot product with the plane tells which side of the face it's on.
+///////////////////////////////////////////////////////////////////////////////
+static void build_face_planes(mesh_t* mesh, arena_t* arena)
+{
+    mesh->face_planes = (vec4_t*)arena_alloc(arena, sizeof(vec4_t) * mesh->num_faces);
+    if (mesh->face_planes == NULL)
+    {
+        // No planes, no faces to draw: the levels of detail (and their meshlets) go too,
+        // so nothing reads past the planes that aren't there
+        mesh->num_faces = 0;
+        memset(mesh->lods, 0, sizeof(mesh->lods));
+        mesh->num_lods = 0;
+        return;
+    }
+    for (int i = 0; i < mesh->num_faces; i++)
+    {
+        // Triangle ACB in clockwise order (CW), same normal direction as the culling always used
+        vec3_t a = mesh->vertices[mesh->indices[i * 3 + 0]];
+        vec3_t b = mesh->vertices[mesh->indices[i * 3 + 1]];
+        vec3_t c = mesh->vertices[mesh->indices[i * 3 + 2]];
+        vec3_t normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+
+        // Degenerate faces keep a zero normal, so they're never culled (like before)
+        float length = vec3_length(normal);
+        if (length > 0)
+            normal = vec3_div(normal, length);
+
+        vec4_t plane = { normal.x, normal.y, normal.z, -vec3_dot(normal, a) };
+        mesh->face_planes[i] = plane;
+    }
+}
+
+// Sphere around the center of the bounding box of the vertices, as big as the furthest one
+static void build_bounds(mesh_t* mesh)
+{
+    vec3_t box_min = { 0, 0, 0 };
+    vec3_t box_max = { 0, 0, 0 };
+    for (int i = 0; i < mesh->num_vertices; i++)
+    {
+        vec3_t v = mesh->vertices[i];
+        if (i == 0)
+            box_min = box_max = v;
+        box_min.x = fminf(box_min.x, v.x);
+        box_min.y = fminf(box_min.y, v.y);
+        box_min.z = fminf(box_min.z, v.z);
+        box_max.x = fmaxf(box_max.x, v.x);
+        box_max.y = fmaxf(box_max.y, v.y);
+        box_max.z = fmaxf(box_max.z, v.z);
+    }
+    mesh->bounds_min = box_min;
+    mesh->bounds_max = box_max;
+    mesh->bounds_center = vec3_mul(vec3_add(box_min, box_max), 0.5f);
+    mesh->bounds_radius = 0.0f;
+    for (int i = 0; i < mesh->num_vertices; i++)
+        mesh->bounds_radius = fmaxf(mesh->bounds_radius, vec3_length(vec3_sub(mesh->vertices[i], mesh->bounds_center)));
+}
+
+// Everything the renderer derives from the vertices and indices, whichever way they were loaded
+static void build_render_data(mesh_t* mesh, arena_t* arena)
+{
+    vertex_stream_build(&mesh->vertex_stream, mesh->vertices, mesh->num_vertices, arena);
+    build_face_planes(mesh, arena);
+    build_bounds(mesh);
+    for (int lod = 0; lod < mesh->num_lods; lod++)
+    {
+        mesh_lod_t* level = &mesh->lods[lod];
+        level->meshlets = build_meshlets(mesh->vertices, mesh->indices, mesh->face_planes,
+            level->first_face, level->num_faces, &level->num_meshlets, arena);
+    }
+}
+
+// Copy an array.h array into the arena and free the original
+static void* move_array_to_arena(void* array, size_t item_size, arena_t* arena)
+{
+    if (array == NULL)
+        return NULL;
+
+    size_t size = array_length(array) * item_size;
+    void* moved = arena_alloc(arena, size);
+    if (moved != NULL)
+        memcpy(moved, array, size);
+    array_free(array);
+    return moved;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Loading and optimizing a mesh allocates and frees (and reallocates) arrays all the time,
+// so that part is done with array.h arrays, and only the final arrays move to the arena,
+// packed one after the other with the rest of the scene's assets.
+///////////////////////////////////////////////////////////////////////////////
+static void move_mesh_to_arena(mesh_t* mesh, arena_t* arena)
 {
-    for (int i = 0; i < N_CUBE_VERTICES; i++)
+    mesh->vertices = (vec3_t*)move_array_to_arena(mesh->vertices, sizeof(vec3_t), arena);
+    mesh->texcoords = (tex2_t*)move_array_to_arena(mesh->texcoords, sizeof(tex2_t), arena);
+    mesh->normals = (vec3_t*)move_array_to_arena(mesh->normals, sizeof(vec3_t), arena);
+    mesh->indices = (uint32_t*)move_array_to_arena(mesh->indices, sizeof(uint32_t), arena);
+
+    if (mesh->vertices == NULL || mesh->texcoords == NULL || mesh->indices == NULL)
     {
-        vec3_t cube_vertex = cube_vertices[i];
-        array_push(mesh.vertices, cube_vertex);
+        mesh->num_vertices = 0;
+        mesh->num_faces = 0;
+        mesh->num_lods = 0;
     }
+}
+
+// Everything zeroed, with a hardcoded white base color for all models
+static void init_mesh(mesh_t* mesh)
+{
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->color = 0xFFFFFFFF;
+}
+
+void load_cube_mesh_data(mesh_t* mesh, arena_t* arena)
+{
+    init_mesh(mesh);
+
+    // Put the cube in the same shape as a parsed .obj file,
+    // so it goes through the same welding as every other mesh
+    obj_t obj = { NULL, NULL, NULL, NULL };
+    array_push_n(obj.vertices, cube_vertices, N_CUBE_VERTICES);
+    array_push_n(obj.texcoords, cube_texcoords, N_CUBE_TEXCOORDS);
+    array_reserve(obj.indices, N_CUBE_FACES * 3);
     for (int i = 0; i < N_CUBE_FACES; i++)
     {
         face_t cube_face = cube_faces[i];
-        array_push(mesh.faces, cube_face);
+        obj_index_t corner_a = { cube_face.a, cube_face.a_uv, cube_face.a_normal };
+        obj_index_t corner_b = { cube_face.b, cube_face.b_uv, cube_face.b_normal };
+        obj_index_t corner_c = { cube_face.c, cube_face.c_uv, cube_face.c_normal };
+        array_push(obj.indices, corner_a);
+        array_push(obj.indices, corner_b);
+        array_push(obj.indices, corner_c);
     }
 
+    build_indexed_mesh(&obj, mesh);
+    obj_free(&obj);
+    optimize_mesh(mesh);
+    generate_mesh_lods(mesh);
+    move_mesh_to_arena(mesh, arena);
+    build_render_data(mesh, arena);
+
     // The following 2 lines is valid code (compiles and runs normally)
     // However since we are using the array MACROS from array.c
     // the line "int num_faces = array_length(mesh.faces);" in main.c
@@ -75,71 +292,75 @@ void load_cube_mesh_data(void)
     // Pikuma's solution was using a for loop from the start,
     // but it bothered on why we couldn't achieve the same behavior in 2 lines
     // and decided to investigate further.
+    // (mesh.faces has since been replaced by the mesh.indices index buffer)
     // 
     //mesh.faces = cube_faces;
     //mesh.vertices = cube_vertices;
 }
 
-void load_obj_file_data(char* filename)
+bool load_obj_file_data(mesh_t* mesh, const char* filename, arena_t* arena)
 {
-    FILE* file;
-    file = fopen(filename, "r");
+    init_mesh(mesh);
 
-    char line[1024];
+    // Map the ready-to-render binary version of the mesh if we converted this .obj before
+    if (!load_mesh_cache(filename, mesh))
+    {
+        obj_t obj;
+        if (!obj_load(filename, &obj))
+            return false;
 
-    tex2_t* texcoords = NULL; // pointer to array of texture coordinates
+        build_indexed_mesh(&obj, mesh);
+        obj_free(&obj);
 
-    while (fgets(line, 1024, file))
-    {
-        // Info regarding .obj line format : https://en.wikipedia.org/wiki/Wavefront_.obj_file
-        // reading this will clear things up on why we compare for "v ", "vt ", "f " etc.
+        // Reorder triangles and vertices for the renderer before caching,
+        // so the (slow-ish) optimization only runs when the .obj changes
+        optimize_mesh(mesh);
 
-        // Vertex information
-        if (strncmp(line, "v ", 2) == 0)
-        {
-            vec3_t vertex;
-            sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh.vertices, vertex);
-        }
+        // The simpler levels of detail go in the cache too, they take longer to build than the rest
+        generate_mesh_lods(mesh);
 
-        // Texture coordinate information
-        if (strncmp(line, "vt ", 3) == 0)
-        {
-            tex2_t texcoord;
-            sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
-            array_push(texcoords, texcoord);
-        }
+        // Write the binary version next to the .obj, so the next run can skip parsing altogether
+        save_mesh_cache(filename, mesh);
 
-        // Face information
-        if (strncmp(line, "f ", 2) == 0)
-        {
-            int vertex_indices[3];
-            int texture_indices[3]; // for UVs
-            int normal_indices[3]; // currently unused, but parsed anyway
-            
-            sscanf(
-                line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0],
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1], 
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]
-            );
-            face_t face = { // arrays in .obj file format start from 1, hence the - 1 part in both vertex and texture indices
-                .a = vertex_indices[0] - 1, // e.g. vertex_indices[0] returns an int index value, for example 5, but we actually need mesh.vertices[4]
-                .b = vertex_indices[1] - 1,
-                .c = vertex_indices[2] - 1,
-                .a_uv = texcoords[texture_indices[0] - 1], // likewise texture_indices return an int index value but we need the previous index to properly access the UVs from texcoords array
-                .b_uv = texcoords[texture_indices[1] - 1], // the reason there are 2 array [[]] symbols used for UVs is that the mesh.vertices array is actually accessed inside update in main.c 
-                .c_uv = texcoords[texture_indices[2] - 1],
-                .color = 0xFFFFFFFF // add a hardcoded white color to all models
-            };
-            
-            // for .obj files teapot & bunny that use a different line format
-            // comment sscanf above and uncomment lines below
-            //face_t face;
-            //sscanf(line, "f %d %d %d", &face.a, &face.b, &face.c);
-            
-            array_push(mesh.faces, face);
-        }
+        move_mesh_to_arena(mesh, arena);
     }
-    array_free(texcoords);
-}
\ No newline at end of file
+
+    build_render_data(mesh, arena);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The error of every level is a distance in object space, and so is the radius of the bounding sphere,
+// so on screen the error is error * screen_radius / radius pixels.
+// Take the simplest level where that's still at most MESH_LOD_SCREEN_ERROR.
+///////////////////////////////////////////////////////////////////////////////
+int select_mesh_lod(const mesh_t* mesh, float screen_radius)
+{
+    if (mesh->bounds_radius <= 0.0f)
+        return 0;
+
+    float pixels_per_unit = screen_radius / mesh->bounds_radius;
+    int lod = 0;
+    while (lod + 1 < mesh->num_lods && mesh->lods[lod + 1].error * pixels_per_unit <= MESH_LOD_SCREEN_ERROR)
+        lod++;
+    return lod;
+}
+
+void free_mesh(mesh_t* mesh)
+{
+    // The arrays belong to the arena the mesh was loaded into (and are freed with it),
+    // or point inside the mapped cache file
+    if (mesh->cache_file.data != NULL)
+        unmap_file(&mesh->cache_file);
+
+    mesh->vertices = NULL;
+    mesh->texcoords = NULL;
+    mesh->normals = NULL;
+    mesh->indices = NULL;
+    mesh->face_planes = NULL;
+    memset(mesh->lods, 0, sizeof(mesh->lods));
+    mesh->num_lods = 0;
+    memset(&mesh->vertex_stream, 0, sizeof(mesh->vertex_stream));
+    mesh->num_vertices = 0;
+    mesh->num_faces = 0;
+}
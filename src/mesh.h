@@ -1,8 +1,14 @@
 #ifndef  MESH_H
 #define MESH_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "vector.h"
 #include "triangle.h"
+#include "file.h"
+#include "vertex_stream.h"
+#include "arena.h"
+#include "meshlet.h"
 
 // Pikuma's comment on extern keyword:
 // Here we are declaring these variables
@@ -11,23 +17,61 @@
 // Also see display.h/.c for some previous extern keyword notes
 
 #define N_CUBE_VERTICES 8
+#define N_CUBE_TEXCOORDS 4
 #define N_CUBE_FACES (6 * 2) // 6 cube faces, 2 triangles per face
 
+#define MESH_MAX_LODS 5 // the full detail mesh and up to 4 simpler versions of it (see mesh_simplifier.h)
+#define MESH_LOD_SCREEN_ERROR 1.0f // largest error (in pixels) a simpler level of detail may show on screen
+
 extern vec3_t cube_vertices[N_CUBE_VERTICES];
+extern tex2_t cube_texcoords[N_CUBE_TEXCOORDS];
 extern face_t cube_faces[N_CUBE_FACES];
 
-// Define a struct for dynamic size meshes, with array of vertices and faces
+// One level of detail of a mesh, a range of faces of its index buffer
+typedef struct {
+	int first_face;      // faces first_face to first_face + num_faces - 1 of the mesh
+	int num_faces;
+	float error;         // how far (in object space) this level can be from the full detail surface
+	meshlet_t* meshlets; // clusters of the faces of this level with their culling bounds (see meshlet.h)
+	int num_meshlets;
+} mesh_lod_t;
+
+// Define a struct for dynamic size meshes, with an indexed vertex buffer.
+// A vertex is a unique (position, uv, normal) combination, so vertices shared
+// by several faces are stored (and later transformed) only once,
+// and faces are just 3 indices into the vertex arrays.
+// The arrays are either allocated from the arena the mesh was loaded into, or point straight inside
+// a memory mapped binary mesh cache (see mesh_cache.h), hence the explicit counts.
 typedef struct {
-	vec3_t* vertices;  // dynamic array of vertices
-	face_t* faces;     // dynamic array of faces
-	vec3_t rotation;   // rotation with x,y and z values
-	vec3_t scale;      // scale with x,y and z values
-	vec3_t translation; // translation with x,y and z values
+	vec3_t* vertices;   // array of vertex positions
+	tex2_t* texcoords;  // array of texture coordinates, one per vertex
+	vec3_t* normals;    // array of vertex normals, one per vertex (NULL if the mesh has no normals)
+	uint32_t* indices;  // index buffer, 3 vertex indices per triangle face
+	int num_vertices;
+	int num_faces;      // number of triangles of all the levels of detail, the index buffer has 3 times as many indices
+	uint32_t color;     // base color of all faces before shading
+	mapped_file_t cache_file; // the binary mesh cache the arrays point to, if any
+	vertex_stream_t vertex_stream; // copy of the vertex positions laid out for the batch transform
+	vec4_t* face_planes; // plane of every face in object space, xyz: unit normal, w: offset (dot(normal, p) + w = 0 on the plane)
+	mesh_lod_t lods[MESH_MAX_LODS]; // lods[0] is the full detail mesh, the faces of the simpler ones follow it
+	int num_lods;
+	vec3_t bounds_min;    // bounding box of the vertices, in object space
+	vec3_t bounds_max;
+	vec3_t bounds_center; // bounding sphere of the vertices, in object space
+	float bounds_radius;
 } mesh_t;
 
-extern mesh_t mesh;
+// A mesh is only the shape, where it goes (and with which texture) is up to the
+// mesh instances that use it (see scene.h), so the same mesh can be drawn any number of times.
+// Everything the loaded mesh needs to be drawn is allocated from arena.
+void load_cube_mesh_data(mesh_t* mesh, arena_t* arena);
+bool load_obj_file_data(mesh_t* mesh, const char* filename, arena_t* arena); // false if the file couldn't be loaded
+
+// Simplest level of detail that still looks right when the bounding sphere of the mesh
+// has a radius of screen_radius pixels on screen
+int select_mesh_lod(const mesh_t* mesh, float screen_radius);
 
-void load_cube_mesh_data(void);
-void load_obj_file_data(char* filename);
+// Unmap the cache file of the mesh, its arrays go away with the arena it was loaded into
+void free_mesh(mesh_t* mesh);
 
 #endif
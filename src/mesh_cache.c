@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file.h"
+#include "mesh_cache.h"
+
+static const char mesh_cache_magic[4] = { 'P', 'S', 'R', 'M' };
+
+// assets/f22.obj -> assets/f22.mesh (remember to free the returned string)
+static char* mesh_cache_filename(const char* obj_filename)
+{
+    size_t length = strlen(obj_filename);
+    if (length >= 4 && strcmp(obj_filename + length - 4, ".obj") == 0)
+        length -= 4;
+
+    char* filename = (char*)malloc(length + sizeof(".mesh"));
+    memcpy(filename, obj_filename, length);
+    memcpy(filename + length, ".mesh", sizeof(".mesh"));
+    return filename;
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+// Check the stream [offset, offset + count * item_size) lies inside the file, so a truncated
+// or corrupted cache can't make us read past the end of the mapping (see indices_fit for what's inside the streams)
+static bool stream_fits(uint64_t offset, uint32_t count, size_t item_size, size_t file_size)
+{
+    return offset % MESH_CACHE_ALIGNMENT == 0
+        && offset <= file_size
+        && (uint64_t)count * item_size <= file_size - offset;
+}
+
+// The levels of detail must cover the whole index stream, in order
+static bool lods_fit(const mesh_cache_header_t* header)
+{
+    if (header->num_lods < 1 || header->num_lods > MESH_MAX_LODS)
+        return false;
+
+    uint64_t num_faces = 0;
+    for (uint32_t lod = 0; lod < header->num_lods; lod++)
+        num_faces += header->lod_num_faces[lod];
+    return num_faces * 3 == header->num_indices;
+}
+
+// Every index must name one of the vertices, or the faces would read vertices past the end of their streams
+static bool indices_fit(const mapped_file_t* file, const mesh_cache_header_t* header)
+{
+    const uint32_t* indices = (const uint32_t*)(file->data + header->indices_offset);
+    for (uint32_t i = 0; i < header->num_indices; i++)
+    {
+        if (indices[i] >= header->num_vertices)
+            return false;
+    }
+    return true;
+}
+
+static void* stream_pointer(const mapped_file_t* file, uint64_t offset, uint32_t count)
+{
+    // The mapping is read-only, the mesh arrays must never be written to
+    return count > 0 ? (void*)(file->data + offset) : NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Point the mesh arrays inside the binary cache of obj_filename.
+// Returns false (quietly) if there is no cache yet, or if it's out of date
+// with the .obj file, in which case the caller should parse the .obj instead.
+///////////////////////////////////////////////////////////////////////////////
+bool load_mesh_cache(const char* obj_filename, mesh_t* mesh)
+{
+    uint64_t source_size;
+    int64_t source_time;
+    if (!file_info(obj_filename, &source_size, &source_time))
+        return false;
+
+    char* cache_filename = mesh_cache_filename(obj_filename);
+    mapped_file_t file;
+    bool mapped = file_exists(cache_filename) && map_file(cache_filename, &file);
+    free(cache_filename);
+    if (!mapped)
+        return false;
+
+    const mesh_cache_header_t* header = (const mesh_cache_header_t*)file.data;
+    bool valid = file.size >= sizeof(mesh_cache_header_t)
+        && memcmp(header->magic, mesh_cache_magic, sizeof(mesh_cache_magic)) == 0
+        && header->version == MESH_CACHE_VERSION
+        && header->header_size == sizeof(mesh_cache_header_t)
+        && header->source_size == source_size
+        && header->source_time == source_time
+        && (header->num_normals == 0 || header->num_normals == header->num_vertices)
+        && header->num_indices % 3 == 0
+        && lods_fit(header)
+        && stream_fits(header->vertices_offset, header->num_vertices, sizeof(vec3_t), file.size)
+        && stream_fits(header->texcoords_offset, header->num_vertices, sizeof(tex2_t), file.size)
+        && stream_fits(header->normals_offset, header->num_normals, sizeof(vec3_t), file.size)
+        && stream_fits(header->indices_offset, header->num_indices, sizeof(uint32_t), file.size)
+        && indices_fit(&file, header);
+
+    if (!valid)
+    {
+        unmap_file(&file);
+        return false;
+    }
+
+    mesh->vertices = (vec3_t*)stream_pointer(&file, header->vertices_offset, header->num_vertices);
+    mesh->texcoords = (tex2_t*)stream_pointer(&file, header->texcoords_offset, header->num_vertices);
+    mesh->normals = (vec3_t*)stream_pointer(&file, header->normals_offset, header->num_normals);
+    mesh->indices = (uint32_t*)stream_pointer(&file, header->indices_offset, header->num_indices);
+    mesh->num_vertices = (int)header->num_vertices;
+    mesh->num_faces = (int)(header->num_indices / 3);
+
+    memset(mesh->lods, 0, sizeof(mesh->lods));
+    int first_face = 0;
+    for (uint32_t lod = 0; lod < header->num_lods; lod++)
+    {
+        mesh->lods[lod].first_face = first_face;
+        mesh->lods[lod].num_faces = (int)header->lod_num_faces[lod];
+        mesh->lods[lod].error = header->lod_errors[lod];
+        first_face += mesh->lods[lod].num_faces;
+    }
+    mesh->num_lods = (int)header->num_lods;
+    mesh->cache_file = file;
+    return true;
+}
+
+// Write one stream at its aligned offset, padding with zeros from the current position
+static bool write_stream(FILE* file, uint64_t* position, uint64_t offset, const void* data, size_t count, size_t item_size)
+{
+    static const char zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+    size_t padding = (size_t)(offset - *position);
+    if (padding > 0 && fwrite(zeros, 1, padding, file) != padding)
+        return false;
+    if (count > 0 && fwrite(data, item_size, count, file) != count)
+        return false;
+    *position = offset + (uint64_t)count * item_size;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert the mesh loaded from obj_filename to its binary cache
+///////////////////////////////////////////////////////////////////////////////
+bool save_mesh_cache(const char* obj_filename, const mesh_t* mesh)
+{
+    mesh_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    if (!file_info(obj_filename, &header.source_size, &header.source_time))
+        return false;
+
+    memcpy(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+    header.version = MESH_CACHE_VERSION;
+    header.header_size = sizeof(mesh_cache_header_t);
+    header.num_vertices = (uint32_t)mesh->num_vertices;
+    header.num_normals = (mesh->normals != NULL) ? (uint32_t)mesh->num_vertices : 0;
+    header.num_indices = (uint32_t)mesh->num_faces * 3;
+    header.num_lods = (uint32_t)mesh->num_lods;
+    for (int lod = 0; lod < mesh->num_lods; lod++)
+    {
+        header.lod_num_faces[lod] = (uint32_t)mesh->lods[lod].num_faces;
+        header.lod_errors[lod] = mesh->lods[lod].error;
+    }
+
+    // Streams go one after the other, each one starting at an aligned offset
+    header.vertices_offset = align_offset(sizeof(mesh_cache_header_t));
+    header.texcoords_offset = align_offset(header.vertices_offset + (uint64_t)header.num_vertices * sizeof(vec3_t));
+    header.normals_offset = align_offset(header.texcoords_offset + (uint64_t)header.num_vertices * sizeof(tex2_t));
+    header.indices_offset = align_offset(header.normals_offset + (uint64_t)header.num_normals * sizeof(vec3_t));
+
+    // The cache is written under a name of its own and then renamed over the old one, so a mesh
+    // still mapping the old cache keeps it intact, other threads (or programs) writing the same cache
+    // at the same time don't write into each other, and readers only ever find complete files
+    char* cache_filename = mesh_cache_filename(obj_filename);
+    char* temp_cache_filename = temp_filename(cache_filename);
+    FILE* file = (temp_cache_filename != NULL) ? fopen(temp_cache_filename, "wb") : NULL;
+    if (file == NULL)
+    {
+        fprintf(stderr, "Warning: couldn't write mesh cache %s.\n", cache_filename);
+        free(temp_cache_filename);
+        free(cache_filename);
+        return false;
+    }
+
+    uint64_t position = 0;
+    bool success = write_stream(file, &position, 0, &header, 1, sizeof(mesh_cache_header_t))
+        && write_stream(file, &position, header.vertices_offset, mesh->vertices, header.num_vertices, sizeof(vec3_t))
+        && write_stream(file, &position, header.texcoords_offset, mesh->texcoords, header.num_vertices, sizeof(tex2_t))
+        && write_stream(file, &position, header.normals_offset, mesh->normals, header.num_normals, sizeof(vec3_t))
+        && write_stream(file, &position, header.indices_offset, mesh->indices, header.num_indices, sizeof(uint32_t));
+    success = (fclose(file) == 0) && success;
+    success = success && replace_file(temp_cache_filename, cache_filename);
+
+    // Never leave a half written cache behind
+    if (!success)
+    {
+        fprintf(stderr, "Warning: couldn't write mesh cache %s.\n", cache_filename);
+        remove(temp_cache_filename);
+    }
+    free(temp_cache_filename);
+    free(cache_filename);
+    return success;
+}
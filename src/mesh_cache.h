@@ -0,0 +1,48 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mesh.h"
+
+// Binary mesh cache, written next to the .obj file it was converted from
+// (assets/f22.obj -> assets/f22.mesh).
+//
+// The file is the header below followed by the vertex, texcoord, normal and index
+// streams, laid out exactly like the mesh_t arrays in memory.
+// The index stream has the faces of every level of detail one after the other, the header says how many each has.
+// Loading it is just mapping the file and pointing the mesh arrays inside it:
+// no parsing and no copying, the OS pages in the data as the renderer touches it.
+//
+// Remember to bump MESH_CACHE_VERSION whenever the layout of the header,
+// or of any of the structs stored in the streams (vec3_t, tex2_t) changes,
+// or when the mesh processing at load time changes what ends up in them.
+#define MESH_CACHE_VERSION 5 // 2: indexed vertex buffer instead of per-attribute face indices
+                             // 3: triangles and vertices reordered by mesh_optimizer.c
+                             // 4: levels of detail from mesh_simplifier.c after the full detail faces
+                             // 5: source_time in nanoseconds on POSIX instead of whole seconds
+#define MESH_CACHE_ALIGNMENT 16 // every stream starts at a multiple of this
+
+typedef struct {
+    char magic[4];            // "PSRM" (Pikuma Software Renderer Mesh)
+    uint32_t version;         // MESH_CACHE_VERSION
+    uint32_t header_size;     // sizeof(mesh_cache_header_t), a cheap sanity check
+    uint32_t num_vertices;    // every vertex has a position and a texcoord
+    uint32_t num_normals;     // either num_vertices, or 0 for meshes without normals
+    uint32_t num_indices;     // 3 per triangle face
+    uint32_t reserved[2];     // keeps the 64-bit fields below aligned
+    uint64_t source_size;     // size of the .obj file the cache was made from
+    int64_t source_time;      // last modification time of that .obj file (see file_info in file.h)
+    uint64_t vertices_offset; // offsets of each stream from the start of the file
+    uint64_t texcoords_offset;
+    uint64_t normals_offset;
+    uint64_t indices_offset;
+    uint32_t num_lods;        // levels of detail, at least the full detail one
+    uint32_t lod_num_faces[MESH_MAX_LODS]; // they add up to num_indices / 3
+    float lod_errors[MESH_MAX_LODS];
+} mesh_cache_header_t;
+
+bool load_mesh_cache(const char* obj_filename, mesh_t* mesh);
+bool save_mesh_cache(const char* obj_filename, const mesh_t* mesh);
+
+#endif
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "array.h"
+#include "mesh_optimizer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Vertex cache optimization
+///////////////////////////////////////////////////////////////////////////////
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+// Every vertex gets a score from its position in a simulated LRU cache
+// (recently used vertices score high) and from how many triangles still use it
+// (vertices with few triangles left score high, so we finish them off instead
+// of leaving lonely triangles behind). Every triangle scores the sum of its 3 vertices,
+// and we greedily emit the best scoring triangle among the ones touching the cache.
+// Even though we don't have a GPU post-transform cache, the same ordering keeps the
+// vertices of consecutive triangles close to each other in projected_vertices.
+///////////////////////////////////////////////////////////////////////////////
+#define VERTEX_CACHE_SIZE 32
+#define VERTEX_CACHE_DECAY_POWER 1.5f
+#define VERTEX_CACHE_LAST_TRIANGLE_SCORE 0.75f
+#define VERTEX_VALENCE_BOOST_SCALE 2.0f
+#define VERTEX_VALENCE_BOOST_POWER 0.5f
+
+static float vertex_score(int cache_position, int remaining_triangles)
+{
+    // No triangles left to draw with this vertex, it's of no use anymore
+    if (remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+        {
+            // Used by the triangle we just emitted, give it a fixed score
+            // so we don't always pick a triangle sharing an edge with it (strips aren't better than fans)
+            score = VERTEX_CACHE_LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, VERTEX_CACHE_DECAY_POWER);
+        }
+    }
+
+    score += VERTEX_VALENCE_BOOST_SCALE * powf((float)remaining_triangles, -VERTEX_VALENCE_BOOST_POWER);
+    return score;
+}
+
+void optimize_vertex_cache(uint32_t* indices, int num_indices, int num_vertices)
+{
+    int num_triangles = num_indices / 3;
+    if (num_triangles == 0)
+        return;
+
+    // Triangles using each vertex: the ones of vertex v are adjacency[offsets[v] .. offsets[v] + remaining[v]]
+    int* remaining = (int*)calloc(num_vertices, sizeof(int));
+    int* offsets = (int*)malloc(sizeof(int) * (num_vertices + 1));
+    int* adjacency = (int*)malloc(sizeof(int) * num_indices);
+
+    for (int i = 0; i < num_indices; i++)
+        remaining[indices[i]]++;
+
+    offsets[0] = 0;
+    for (int v = 0; v < num_vertices; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    memset(remaining, 0, sizeof(int) * num_vertices);
+    for (int i = 0; i < num_indices; i++)
+    {
+        uint32_t v = indices[i];
+        adjacency[offsets[v] + remaining[v]++] = i / 3;
+    }
+
+    // Initial scores, nothing is in the cache yet
+    int* cache_positions = (int*)malloc(sizeof(int) * num_vertices);
+    float* vertex_scores = (float*)malloc(sizeof(float) * num_vertices);
+    for (int v = 0; v < num_vertices; v++)
+    {
+        cache_positions[v] = -1;
+        vertex_scores[v] = vertex_score(-1, remaining[v]);
+    }
+
+    float* triangle_scores = (float*)malloc(sizeof(float) * num_triangles);
+    bool* emitted = (bool*)calloc(num_triangles, sizeof(bool));
+    int best_triangle = 0;
+    for (int t = 0; t < num_triangles; t++)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        triangle_scores[t] = vertex_scores[triangle[0]] + vertex_scores[triangle[1]] + vertex_scores[triangle[2]];
+        if (triangle_scores[t] > triangle_scores[best_triangle])
+            best_triangle = t;
+    }
+
+    // The reordered triangles go here, and get copied over the input at the end
+    uint32_t* output = (uint32_t*)malloc(sizeof(uint32_t) * num_triangles * 3);
+
+    // One extra slot per corner of the emitted triangle, they get pushed in front before the oldest fall off
+    int cache[VERTEX_CACHE_SIZE + 3];
+    int new_cache[VERTEX_CACHE_SIZE + 3];
+    int cache_count = 0;
+    int next_unemitted = 0; // for when the cache runs dry, every triangle before this one is emitted
+
+    for (int output_triangle = 0; output_triangle < num_triangles; output_triangle++)
+    {
+        const uint32_t* triangle = &indices[best_triangle * 3];
+        memcpy(&output[output_triangle * 3], triangle, sizeof(uint32_t) * 3);
+        emitted[best_triangle] = true;
+
+        // Take the emitted triangle off the adjacency lists of its vertices
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = triangle[k];
+            int* vertex_triangles = &adjacency[offsets[v]];
+            for (int j = 0; j < remaining[v]; j++)
+            {
+                if (vertex_triangles[j] == best_triangle)
+                {
+                    vertex_triangles[j] = vertex_triangles[remaining[v] - 1];
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        // The triangle vertices move to the front of the LRU cache, the rest keep their order behind them
+        int new_cache_count = 0;
+        for (int k = 0; k < 3; k++)
+            new_cache[new_cache_count++] = (int)triangle[k];
+        for (int j = 0; j < cache_count; j++)
+        {
+            int v = cache[j];
+            if (v != (int)triangle[0] && v != (int)triangle[1] && v != (int)triangle[2])
+                new_cache[new_cache_count++] = v;
+        }
+
+        // Vertices that fell off the end of the cache
+        for (int j = VERTEX_CACHE_SIZE; j < new_cache_count; j++)
+        {
+            int v = new_cache[j];
+            cache_positions[v] = -1;
+            vertex_scores[v] = vertex_score(-1, remaining[v]);
+        }
+
+        cache_count = (new_cache_count < VERTEX_CACHE_SIZE) ? new_cache_count : VERTEX_CACHE_SIZE;
+        for (int j = 0; j < cache_count; j++)
+        {
+            int v = new_cache[j];
+            cache[j] = v;
+            cache_positions[v] = j;
+            vertex_scores[v] = vertex_score(j, remaining[v]);
+        }
+
+        // Rescore the triangles around the cache, the next triangle is the best one of them
+        best_triangle = -1;
+        float best_score = -1.0f;
+        for (int j = 0; j < cache_count; j++)
+        {
+            int v = cache[j];
+            const int* vertex_triangles = &adjacency[offsets[v]];
+            for (int n = 0; n < remaining[v]; n++)
+            {
+                int t = vertex_triangles[n];
+                const uint32_t* candidate = &indices[t * 3];
+                float score = vertex_scores[candidate[0]] + vertex_scores[candidate[1]] + vertex_scores[candidate[2]];
+                triangle_scores[t] = score;
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best_triangle = t;
+                }
+            }
+        }
+
+        // Nothing left around the cache, jump to the first triangle we haven't emitted yet
+        if (best_triangle < 0)
+        {
+            while (next_unemitted < num_triangles && emitted[next_unemitted])
+                next_unemitted++;
+            best_triangle = next_unemitted;
+        }
+    }
+
+    memcpy(indices, output, sizeof(uint32_t) * num_triangles * 3);
+
+    free(output);
+    free(emitted);
+    free(triangle_scores);
+    free(vertex_scores);
+    free(cache_positions);
+    free(adjacency);
+    free(offsets);
+    free(remaining);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Overdraw optimization
+///////////////////////////////////////////////////////////////////////////////
+// Based on "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+// (Sander, Nehab, Barczak), the second half of Tipsify.
+// The vertex cache ordered triangles are cut into clusters where reordering them
+// barely hurts the cache, and the clusters get sorted so the ones on the outside
+// of the mesh facing away from its center come first. From most view directions
+// those are the ones in front, so the triangles behind them fail the z-test before
+// we spend any time interpolating and texturing their pixels.
+///////////////////////////////////////////////////////////////////////////////
+#define OVERDRAW_CACHE_SIZE 16
+#define OVERDRAW_CACHE_THRESHOLD 1.05f // how much worse than the original cluster order we're willing to get
+
+typedef struct {
+    int start;  // first triangle of the cluster
+    int count;  // number of triangles
+    float sort_key;
+} triangle_cluster_t;
+
+// FIFO cache simulation: a vertex is in the cache if it was loaded in the last OVERDRAW_CACHE_SIZE misses.
+// Bumping the timestamp past the cache size empties the whole cache at once.
+static int triangle_cache_misses(const uint32_t* triangle, unsigned int* cache_timestamps, unsigned int* timestamp)
+{
+    int misses = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        uint32_t v = triangle[k];
+        if (*timestamp - cache_timestamps[v] > OVERDRAW_CACHE_SIZE)
+        {
+            cache_timestamps[v] = (*timestamp)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+static int compare_clusters(const void* a, const void* b)
+{
+    const triangle_cluster_t* cluster_a = (const triangle_cluster_t*)a;
+    const triangle_cluster_t* cluster_b = (const triangle_cluster_t*)b;
+
+    // Biggest key first, ties keep their original order so the result doesn't depend on qsort
+    if (cluster_a->sort_key != cluster_b->sort_key)
+        return (cluster_a->sort_key > cluster_b->sort_key) ? -1 : 1;
+    return cluster_a->start - cluster_b->start;
+}
+
+void optimize_overdraw(uint32_t* indices, int num_indices, const vec3_t* vertices, int num_vertices)
+{
+    int num_triangles = num_indices / 3;
+    if (num_triangles == 0)
+        return;
+
+    unsigned int* cache_timestamps = (unsigned int*)calloc(num_vertices, sizeof(unsigned int));
+    unsigned int timestamp = OVERDRAW_CACHE_SIZE + 1;
+
+    // Hard boundaries: triangles missing the cache on all 3 vertices start somewhere new anyway
+    int* hard_starts = NULL;
+    int first_triangle = 0;
+    array_push(hard_starts, first_triangle);
+    for (int t = 0; t < num_triangles; t++)
+    {
+        if (triangle_cache_misses(&indices[t * 3], cache_timestamps, &timestamp) == 3 && t > 0)
+            array_push(hard_starts, t);
+    }
+
+    // Soft boundaries: split hard clusters further wherever the cache hit rate so far
+    // is already about as good as the one of the whole cluster
+    triangle_cluster_t* clusters = NULL;
+    int num_hard_clusters = array_length(hard_starts);
+    for (int h = 0; h < num_hard_clusters; h++)
+    {
+        int start = hard_starts[h];
+        int end = (h + 1 < num_hard_clusters) ? hard_starts[h + 1] : num_triangles;
+
+        timestamp += OVERDRAW_CACHE_SIZE + 1;
+        int cluster_misses = 0;
+        for (int t = start; t < end; t++)
+            cluster_misses += triangle_cache_misses(&indices[t * 3], cache_timestamps, &timestamp);
+        float cluster_threshold = OVERDRAW_CACHE_THRESHOLD * (float)cluster_misses / (float)(end - start);
+
+        timestamp += OVERDRAW_CACHE_SIZE + 1;
+        int running_misses = 0;
+        int cluster_start = start;
+        for (int t = start; t < end; t++)
+        {
+            running_misses += triangle_cache_misses(&indices[t * 3], cache_timestamps, &timestamp);
+            int running_triangles = t - cluster_start + 1;
+
+            if ((float)running_misses / (float)running_triangles <= cluster_threshold || t == end - 1)
+            {
+                triangle_cluster_t cluster = { cluster_start, running_triangles, 0.0f };
+                array_push(clusters, cluster);
+
+                // The next cluster may be drawn after any other one, so it starts with a cold cache
+                timestamp += OVERDRAW_CACHE_SIZE + 1;
+                running_misses = 0;
+                cluster_start = t + 1;
+            }
+        }
+    }
+    array_free(hard_starts);
+    free(cache_timestamps);
+
+    // Center of the mesh, the average of all corners
+    vec3_t mesh_center = { 0, 0, 0 };
+    for (int i = 0; i < num_indices; i++)
+        mesh_center = vec3_add(mesh_center, vertices[indices[i]]);
+    mesh_center = vec3_div(mesh_center, (float)num_indices);
+
+    // Sort key: how far out in the direction it's facing the cluster is from the mesh center
+    int num_clusters = array_length(clusters);
+    for (int i = 0; i < num_clusters; i++)
+    {
+        vec3_t centroid = { 0, 0, 0 };
+        vec3_t normal = { 0, 0, 0 };
+        float area = 0.0f;
+
+        for (int t = clusters[i].start; t < clusters[i].start + clusters[i].count; t++)
+        {
+            vec3_t a = vertices[indices[t * 3 + 0]];
+            vec3_t b = vertices[indices[t * 3 + 1]];
+            vec3_t c = vertices[indices[t * 3 + 2]];
+
+            // Same face normal as the backface culling in main.c, its length is twice the triangle area
+            vec3_t face_normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+            float face_area = vec3_length(face_normal);
+
+            vec3_t face_center = vec3_div(vec3_add(vec3_add(a, b), c), 3.0f);
+            centroid = vec3_add(centroid, vec3_mul(face_center, face_area));
+            normal = vec3_add(normal, face_normal);
+            area += face_area;
+        }
+
+        if (area > 0.0f)
+            centroid = vec3_div(centroid, area);
+        float normal_length = vec3_length(normal);
+        if (normal_length > 0.0f)
+            normal = vec3_div(normal, normal_length);
+
+        clusters[i].sort_key = vec3_dot(vec3_sub(centroid, mesh_center), normal);
+    }
+
+    qsort(clusters, num_clusters, sizeof(triangle_cluster_t), compare_clusters);
+
+    uint32_t* output = (uint32_t*)malloc(sizeof(uint32_t) * num_triangles * 3);
+    int output_index = 0;
+    for (int i = 0; i < num_clusters; i++)
+    {
+        memcpy(&output[output_index], &indices[clusters[i].start * 3], sizeof(uint32_t) * clusters[i].count * 3);
+        output_index += clusters[i].count * 3;
+    }
+    memcpy(indices, output, sizeof(uint32_t) * num_triangles * 3);
+
+    free(output);
+    array_free(clusters);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vertex fetch optimization
+///////////////////////////////////////////////////////////////////////////////
+// After the triangles are reordered, renumber the vertices in the order the
+// triangles first use them, so walking the index buffer walks the vertex arrays
+// (and projected_vertices) mostly front to back.
+// Vertices no triangle uses are dropped on the way.
+// The mesh arrays must be our own (not pointing into a mapped cache file).
+///////////////////////////////////////////////////////////////////////////////
+void optimize_vertex_fetch(mesh_t* mesh)
+{
+    int num_indices = mesh->num_faces * 3;
+
+    int* remap = (int*)malloc(sizeof(int) * mesh->num_vertices);
+    for (int v = 0; v < mesh->num_vertices; v++)
+        remap[v] = -1;
+
+    int num_vertices = 0;
+    for (int i = 0; i < num_indices; i++)
+    {
+        uint32_t v = mesh->indices[i];
+        if (remap[v] < 0)
+            remap[v] = num_vertices++;
+        mesh->indices[i] = (uint32_t)remap[v];
+    }
+
+    vec3_t* vertices = array_hold(NULL, num_vertices, sizeof(vec3_t));
+    tex2_t* texcoords = array_hold(NULL, num_vertices, sizeof(tex2_t));
+    vec3_t* normals = (mesh->normals != NULL) ? array_hold(NULL, num_vertices, sizeof(vec3_t)) : NULL;
+
+    for (int v = 0; v < mesh->num_vertices; v++)
+    {
+        int new_v = remap[v];
+        if (new_v < 0)
+            continue;
+        vertices[new_v] = mesh->vertices[v];
+        texcoords[new_v] = mesh->texcoords[v];
+        if (normals != NULL)
+            normals[new_v] = mesh->normals[v];
+    }
+    free(remap);
+
+    array_free(mesh->vertices);
+    array_free(mesh->texcoords);
+    array_free(mesh->normals);
+    mesh->vertices = vertices;
+    mesh->texcoords = texcoords;
+    mesh->normals = normals;
+    mesh->num_vertices = num_vertices;
+}
+
+void optimize_mesh(mesh_t* mesh)
+{
+    int num_indices = mesh->num_faces * 3;
+
+    // Order matters: overdraw sorting works on the clusters the vertex cache order produced,
+    // and the vertex renumbering follows the final triangle order
+    optimize_vertex_cache(mesh->indices, num_indices, mesh->num_vertices);
+    optimize_overdraw(mesh->indices, num_indices, mesh->vertices, mesh->num_vertices);
+    optimize_vertex_fetch(mesh);
+}
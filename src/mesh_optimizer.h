@@ -0,0 +1,25 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stdint.h>
+#include "vector.h"
+#include "mesh.h"
+
+// Mesh optimizations that only reorder data, the mesh looks exactly the same afterwards.
+// They run once at load time, before the mesh is written to its binary cache,
+// so later runs get the optimized mesh for free.
+
+// Reorder triangles so consecutive triangles share vertices (Tom Forsyth's algorithm)
+void optimize_vertex_cache(uint32_t* indices, int num_indices, int num_vertices);
+
+// Reorder clusters of triangles so the outer/front-facing ones tend to be drawn first,
+// which makes the z-buffer reject more hidden pixels before they get shaded
+void optimize_overdraw(uint32_t* indices, int num_indices, const vec3_t* vertices, int num_vertices);
+
+// Renumber vertices in the order the index buffer first uses them
+void optimize_vertex_fetch(mesh_t* mesh);
+
+// All of the above, in the right order
+void optimize_mesh(mesh_t* mesh);
+
+#endif
@@ -0,0 +1,706 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "array.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+#define NO_VERTEX 0xFFFFFFFFu     // no vertex at all
+#define MANY_VERTICES 0xFFFFFFFEu // more than one vertex, when only one would make sense
+
+///////////////////////////////////////////////////////////////////////////////
+// Quadrics
+///////////////////////////////////////////////////////////////////////////////
+// A quadric gives the sum of the squared distances from a point to a set of planes,
+// Q(p) = p^T A p + 2 b.p + c, and adding two quadrics gives the quadric of both sets of planes.
+// Every vertex starts with the planes of the triangles around it, and when it collapses
+// into a neighbor its quadric is added to the neighbor's, so the error of a later collapse
+// is the distance to all the original triangles merged there.
+//
+// The points have 5 dimensions, the position and the texture coordinates (scaled to the size of the mesh),
+// and the planes are the triangles themselves in that space (Garland and Heckbert's extension
+// to vertex attributes): moving a vertex to where the texture would get stretched
+// costs as much as moving it off the surface.
+///////////////////////////////////////////////////////////////////////////////
+#define QUADRIC_SIZE 5
+
+typedef struct {
+    double a[15]; // the symmetric matrix A, upper triangle only
+    double b[QUADRIC_SIZE];
+    double c;
+    double weight; // total area of the triangles in the quadric
+} quadric_t;
+
+static const int quadric_index[QUADRIC_SIZE][QUADRIC_SIZE] = {
+    { 0, 1, 2, 3, 4 },
+    { 1, 5, 6, 7, 8 },
+    { 2, 6, 9, 10, 11 },
+    { 3, 7, 10, 12, 13 },
+    { 4, 8, 11, 13, 14 }
+};
+
+static double dot5(const double* a, const double* b)
+{
+    double dot = 0;
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+        dot += a[i] * b[i];
+    return dot;
+}
+
+static void quadric_add(quadric_t* quadric, const quadric_t* other)
+{
+    for (int i = 0; i < 15; i++)
+        quadric->a[i] += other->a[i];
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+        quadric->b[i] += other->b[i];
+    quadric->c += other->c;
+    quadric->weight += other->weight;
+}
+
+// Squared distance from p to the planes of the quadric, per unit of their area
+static double quadric_error(const quadric_t* quadric, const double* p)
+{
+    double error = quadric->c;
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+    {
+        double row = 0;
+        for (int j = 0; j < QUADRIC_SIZE; j++)
+            row += quadric->a[quadric_index[i][j]] * p[j];
+        error += p[i] * (row + 2 * quadric->b[i]);
+    }
+    if (quadric->weight > 0)
+        error /= quadric->weight;
+
+    // Rounding can take it a little below 0
+    return (error > 0) ? error : 0;
+}
+
+// The squared distance to the plane of triangle p0 p1 p2 is |p - p0|^2 minus its projections on 2 orthonormal
+// vectors e1 and e2 of the plane: A = I - e1 e1^T - e2 e2^T, b = (p0.e1) e1 + (p0.e2) e2 - p0, c = p0.p0 - (p0.e1)^2 - (p0.e2)^2
+static void quadric_add_triangle(quadric_t* quadric, const double* p0, const double* p1, const double* p2, double weight)
+{
+    double e1[QUADRIC_SIZE], e2[QUADRIC_SIZE];
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+    {
+        e1[i] = p1[i] - p0[i];
+        e2[i] = p2[i] - p0[i];
+    }
+
+    double length = sqrt(dot5(e1, e1));
+    if (length == 0)
+        return;
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+        e1[i] /= length;
+
+    double projection = dot5(e2, e1);
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+        e2[i] -= projection * e1[i];
+    length = sqrt(dot5(e2, e2));
+    if (length == 0)
+        return;
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+        e2[i] /= length;
+
+    double p0_e1 = dot5(p0, e1);
+    double p0_e2 = dot5(p0, e2);
+    for (int i = 0; i < QUADRIC_SIZE; i++)
+    {
+        for (int j = i; j < QUADRIC_SIZE; j++)
+            quadric->a[quadric_index[i][j]] += weight * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+        quadric->b[i] += weight * (p0_e1 * e1[i] + p0_e2 * e2[i] - p0[i]);
+    }
+    quadric->c += weight * (dot5(p0, p0) - p0_e1 * p0_e1 - p0_e2 * p0_e2);
+    quadric->weight += weight;
+}
+
+// Plane normal.p + offset = 0 in the position part only, to keep a point on it
+static void quadric_add_plane(quadric_t* quadric, vec3_t normal, float offset, double weight)
+{
+    double n[3] = { normal.x, normal.y, normal.z };
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = i; j < 3; j++)
+            quadric->a[quadric_index[i][j]] += weight * n[i] * n[j];
+        quadric->b[i] += weight * offset * n[i];
+    }
+    quadric->c += weight * offset * offset;
+}
+
+static void vertex_point(double* p, const vec3_t* vertices, const tex2_t* texcoords, uint32_t v, double texcoord_scale)
+{
+    p[0] = vertices[v].x;
+    p[1] = vertices[v].y;
+    p[2] = vertices[v].z;
+    p[3] = texcoords[v].u * texcoord_scale;
+    p[4] = texcoords[v].v * texcoord_scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Edges
+///////////////////////////////////////////////////////////////////////////////
+// Set of directed edges (a, b), open addressing on the 2 indices packed in 64 bits
+typedef struct {
+    uint64_t* keys; // UINT64_MAX for empty slots
+    uint32_t mask;
+} edge_set_t;
+
+static uint32_t hash_edge(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static void edge_set_init(edge_set_t* set, int max_edges)
+{
+    // Power of two size, at most half full so probe chains stay short
+    uint32_t size = 16;
+    while (size < (uint32_t)max_edges * 2)
+        size *= 2;
+    set->keys = (uint64_t*)malloc(sizeof(uint64_t) * size);
+    memset(set->keys, 0xFF, sizeof(uint64_t) * size);
+    set->mask = size - 1;
+}
+
+static void edge_set_insert(edge_set_t* set, uint32_t a, uint32_t b)
+{
+    uint64_t key = ((uint64_t)a << 32) | b;
+    uint32_t slot = hash_edge(key) & set->mask;
+    while (set->keys[slot] != UINT64_MAX && set->keys[slot] != key)
+        slot = (slot + 1) & set->mask;
+    set->keys[slot] = key;
+}
+
+static bool edge_set_contains(const edge_set_t* set, uint32_t a, uint32_t b)
+{
+    uint64_t key = ((uint64_t)a << 32) | b;
+    uint32_t slot = hash_edge(key) & set->mask;
+    while (set->keys[slot] != UINT64_MAX)
+    {
+        if (set->keys[slot] == key)
+            return true;
+        slot = (slot + 1) & set->mask;
+    }
+    return false;
+}
+
+static void edge_set_clear(edge_set_t* set)
+{
+    memset(set->keys, 0xFF, sizeof(uint64_t) * ((size_t)set->mask + 1));
+}
+
+// For every vertex v, the other end of its open edges: open_out[v] = w for the edge (v, w) of a triangle
+// that no other triangle has as (w, v), open_in[v] = u for such an edge (u, v).
+// NO_VERTEX when v has no such edge, MANY_VERTICES when it has more than one.
+static void find_open_edges(const uint32_t* indices, int num_indices, int num_vertices, edge_set_t* edges, uint32_t* open_out, uint32_t* open_in)
+{
+    edge_set_clear(edges);
+    for (int i = 0; i < num_indices; i += 3)
+        for (int k = 0; k < 3; k++)
+            edge_set_insert(edges, indices[i + k], indices[i + (k + 1) % 3]);
+
+    for (int v = 0; v < num_vertices; v++)
+    {
+        open_out[v] = NO_VERTEX;
+        open_in[v] = NO_VERTEX;
+    }
+    for (int i = 0; i < num_indices; i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = indices[i + k];
+            uint32_t b = indices[i + (k + 1) % 3];
+            if (edge_set_contains(edges, b, a))
+                continue;
+            open_out[a] = (open_out[a] == NO_VERTEX) ? b : MANY_VERTICES;
+            open_in[b] = (open_in[b] == NO_VERTEX) ? a : MANY_VERTICES;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vertex classification
+///////////////////////////////////////////////////////////////////////////////
+// Vertices at the same position with different texture coordinates (or normals) are the two sides of a UV seam.
+// Each vertex only belongs to the triangles of its side, so on its own every side looks like an open border,
+// and collapsing one side without the other would tear the seam open.
+enum vertex_kind {
+    VERTEX_MANIFOLD, // inside a closed part of the surface, can collapse into any neighbor
+    VERTEX_BORDER,   // on an open border of the surface, only collapses along it
+    VERTEX_SEAM,     // one side of a UV seam, collapses along it together with the other side
+    VERTEX_LOCKED    // anything more complicated (seam corners, non-manifold spots), never moves
+};
+
+// position_of[v] is the first vertex at the same position as v, and next_wedge links all the vertices
+// at the same position in a circular list (next_wedge[v] == v for a vertex alone at its position)
+static void build_position_remap(const vec3_t* vertices, int num_vertices, uint32_t* position_of, uint32_t* next_wedge)
+{
+    uint32_t table_size = 16;
+    while (table_size < (uint32_t)num_vertices * 2)
+        table_size *= 2;
+    uint32_t table_mask = table_size - 1;
+    uint32_t* table = (uint32_t*)malloc(sizeof(uint32_t) * table_size);
+    memset(table, 0xFF, sizeof(uint32_t) * table_size);
+
+    for (int v = 0; v < num_vertices; v++)
+    {
+        // + 0.0f turns -0 into 0, they have different bits but are the same position
+        float position[3] = { vertices[v].x + 0.0f, vertices[v].y + 0.0f, vertices[v].z + 0.0f };
+        uint32_t bits[3];
+        memcpy(bits, position, sizeof(bits));
+        uint32_t hash = bits[0] * 0x9E3779B1u;
+        hash ^= bits[1] * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+        hash ^= bits[2] * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+
+        uint32_t slot = (hash ^ (hash >> 16)) & table_mask;
+        while (table[slot] != NO_VERTEX)
+        {
+            vec3_t other = vertices[table[slot]];
+            if (other.x == position[0] && other.y == position[1] && other.z == position[2])
+                break;
+            slot = (slot + 1) & table_mask;
+        }
+
+        if (table[slot] == NO_VERTEX)
+        {
+            table[slot] = (uint32_t)v;
+            position_of[v] = (uint32_t)v;
+            next_wedge[v] = (uint32_t)v;
+        }
+        else
+        {
+            uint32_t first = table[slot];
+            position_of[v] = first;
+            next_wedge[v] = next_wedge[first];
+            next_wedge[first] = (uint32_t)v;
+        }
+    }
+    free(table);
+}
+
+static void classify_vertices(const uint32_t* indices, int num_indices, int num_vertices,
+    const uint32_t* position_of, const uint32_t* next_wedge, const uint32_t* open_out, const uint32_t* open_in, unsigned char* kinds)
+{
+    // The same edges by position, an open edge that's closed by position is a seam, otherwise a border
+    edge_set_t position_edges;
+    edge_set_init(&position_edges, num_indices);
+    for (int i = 0; i < num_indices; i += 3)
+        for (int k = 0; k < 3; k++)
+            edge_set_insert(&position_edges, position_of[indices[i + k]], position_of[indices[i + (k + 1) % 3]]);
+
+    for (int v = 0; v < num_vertices; v++)
+    {
+        uint32_t out = open_out[v];
+        uint32_t in = open_in[v];
+        uint32_t wedge = next_wedge[v];
+        kinds[v] = VERTEX_LOCKED;
+
+        if (wedge == (uint32_t)v)
+        {
+            if (out == NO_VERTEX && in == NO_VERTEX)
+                kinds[v] = VERTEX_MANIFOLD;
+            else if (out < MANY_VERTICES && in < MANY_VERTICES
+                && !edge_set_contains(&position_edges, position_of[out], position_of[v])
+                && !edge_set_contains(&position_edges, position_of[v], position_of[in]))
+                kinds[v] = VERTEX_BORDER; // a single border going through, with no seam ending here
+        }
+        else if (next_wedge[wedge] == (uint32_t)v)
+        {
+            // Two sides, each with a single open edge in and out, and the edges of one side
+            // running along the edges of the other the opposite way
+            uint32_t wedge_out = open_out[wedge];
+            uint32_t wedge_in = open_in[wedge];
+            if (out < MANY_VERTICES && in < MANY_VERTICES && wedge_out < MANY_VERTICES && wedge_in < MANY_VERTICES
+                && position_of[out] == position_of[wedge_in] && position_of[in] == position_of[wedge_out])
+                kinds[v] = VERTEX_SEAM;
+        }
+    }
+    free(position_edges.keys);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Edge collapses
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    uint32_t v; // v moves to u, and the triangles with both are gone
+    uint32_t u;
+    double error;
+} collapse_t;
+
+typedef struct {
+    const vec3_t* vertices;
+    const tex2_t* texcoords;
+    double texcoord_scale;
+    const uint32_t* position_of;
+    const uint32_t* next_wedge;
+    const unsigned char* kinds;
+    const uint32_t* open_out;
+    const uint32_t* open_in;
+    const quadric_t* quadrics;
+    const uint32_t* indices;   // current index buffer
+    const int* first_triangle; // triangles around v: triangles[first_triangle[v] .. first_triangle[v + 1]]
+    const int* triangles;
+} simplifier_t;
+
+// When a seam vertex v moves to u, the other side of the seam w has to move along the same edge to u's other side
+static uint32_t seam_target(const simplifier_t* s, uint32_t v, uint32_t u)
+{
+    uint32_t wedge = s->next_wedge[v];
+    uint32_t target = (u == s->open_out[v]) ? s->open_in[wedge] : s->open_out[wedge];
+    if (target >= MANY_VERTICES || s->position_of[target] != s->position_of[u])
+        return NO_VERTEX;
+    return target;
+}
+
+// Error of moving v to u, or a negative value when v can't go there
+static double collapse_error(const simplifier_t* s, uint32_t v, uint32_t u)
+{
+    unsigned char kind = s->kinds[v];
+    if (kind == VERTEX_LOCKED)
+        return -1;
+    if (kind != VERTEX_MANIFOLD && u != s->open_out[v] && u != s->open_in[v])
+        return -1;
+
+    double p[QUADRIC_SIZE];
+    vertex_point(p, s->vertices, s->texcoords, u, s->texcoord_scale);
+    double error = quadric_error(&s->quadrics[v], p);
+
+    if (kind == VERTEX_SEAM)
+    {
+        uint32_t target = seam_target(s, v, u);
+        if (target == NO_VERTEX)
+            return -1;
+        vertex_point(p, s->vertices, s->texcoords, target, s->texcoord_scale);
+        error += quadric_error(&s->quadrics[s->next_wedge[v]], p);
+    }
+    return error;
+}
+
+// Moving v to u must not flip any of the triangles that stay (the ones without u),
+// or fold them too far (more than about 75 degrees)
+static bool collapse_keeps_orientation(const simplifier_t* s, uint32_t v, uint32_t u)
+{
+    vec3_t position = s->vertices[v];
+    vec3_t target = s->vertices[u];
+    for (int t = s->first_triangle[v]; t < s->first_triangle[v + 1]; t++)
+    {
+        const uint32_t* triangle = &s->indices[s->triangles[t] * 3];
+        int k = (triangle[0] == v) ? 0 : (triangle[1] == v) ? 1 : 2;
+        uint32_t b = triangle[(k + 1) % 3];
+        uint32_t c = triangle[(k + 2) % 3];
+        if (s->position_of[b] == s->position_of[u] || s->position_of[c] == s->position_of[u])
+            continue;
+
+        vec3_t pb = s->vertices[b];
+        vec3_t pc = s->vertices[c];
+        vec3_t normal = vec3_cross(vec3_sub(pb, position), vec3_sub(pc, position));
+        vec3_t new_normal = vec3_cross(vec3_sub(pb, target), vec3_sub(pc, target));
+        float length = vec3_length(normal);
+        if (length > 0 && vec3_dot(normal, new_normal) <= 0.25f * length * vec3_length(new_normal))
+            return false;
+    }
+    return true;
+}
+
+// Triangles around v that also have u, the ones the collapse removes
+static int count_shared_triangles(const simplifier_t* s, uint32_t v, uint32_t u)
+{
+    int count = 0;
+    for (int t = s->first_triangle[v]; t < s->first_triangle[v + 1]; t++)
+    {
+        const uint32_t* triangle = &s->indices[s->triangles[t] * 3];
+        if (triangle[0] == u || triangle[1] == u || triangle[2] == u)
+            count++;
+    }
+    return count;
+}
+
+static void lock_triangles_around(const simplifier_t* s, uint32_t v, unsigned char* locked)
+{
+    for (int t = s->first_triangle[v]; t < s->first_triangle[v + 1]; t++)
+    {
+        const uint32_t* triangle = &s->indices[s->triangles[t] * 3];
+        for (int k = 0; k < 3; k++)
+            locked[s->position_of[triangle[k]]] = 1;
+    }
+}
+
+static int compare_collapses(const void* a, const void* b)
+{
+    double error_a = ((const collapse_t*)a)->error;
+    double error_b = ((const collapse_t*)b)->error;
+    return (error_a > error_b) - (error_a < error_b);
+}
+
+// Triangles using each vertex, like the adjacency in optimize_vertex_cache
+static void build_vertex_triangles(const uint32_t* indices, int num_indices, int num_vertices, int* first_triangle, int* triangles)
+{
+    memset(first_triangle, 0, sizeof(int) * (num_vertices + 1));
+    for (int i = 0; i < num_indices; i++)
+        first_triangle[indices[i] + 1]++;
+    for (int v = 0; v < num_vertices; v++)
+        first_triangle[v + 1] += first_triangle[v];
+
+    int* fill = (int*)malloc(sizeof(int) * num_vertices);
+    memcpy(fill, first_triangle, sizeof(int) * num_vertices);
+    for (int i = 0; i < num_indices; i++)
+        triangles[fill[indices[i]]++] = i / 3;
+    free(fill);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The simplification runs in passes. Every pass finds the cheapest valid collapse of every edge,
+// sorts them, and does them cheapest first while they're not much worse than
+// the ones the pass needs to reach the target. Once a vertex moves, the triangles around it are
+// off limits until the next pass, so every collapse of a pass sees the geometry its error was computed on.
+///////////////////////////////////////////////////////////////////////////////
+int simplify_mesh(uint32_t* destination, const uint32_t* indices, int num_indices,
+    const vec3_t* vertices, const tex2_t* texcoords, int num_vertices, int target_num_indices, float* result_error)
+{
+    memcpy(destination, indices, sizeof(uint32_t) * num_indices);
+    *result_error = 0;
+    if (num_indices <= target_num_indices || num_vertices == 0)
+        return num_indices;
+
+    // Texture coordinates go from 0 to 1, scale them to the size of the mesh
+    vec3_t box_min = vertices[indices[0]];
+    vec3_t box_max = box_min;
+    for (int i = 1; i < num_indices; i++)
+    {
+        vec3_t p = vertices[indices[i]];
+        box_min.x = fminf(box_min.x, p.x);
+        box_min.y = fminf(box_min.y, p.y);
+        box_min.z = fminf(box_min.z, p.z);
+        box_max.x = fmaxf(box_max.x, p.x);
+        box_max.y = fmaxf(box_max.y, p.y);
+        box_max.z = fmaxf(box_max.z, p.z);
+    }
+    double texcoord_scale = vec3_length(vec3_sub(box_max, box_min)) * MESH_LOD_TEXCOORD_WEIGHT;
+
+    uint32_t* position_of = (uint32_t*)malloc(sizeof(uint32_t) * num_vertices);
+    uint32_t* next_wedge = (uint32_t*)malloc(sizeof(uint32_t) * num_vertices);
+    uint32_t* open_out = (uint32_t*)malloc(sizeof(uint32_t) * num_vertices);
+    uint32_t* open_in = (uint32_t*)malloc(sizeof(uint32_t) * num_vertices);
+    unsigned char* kinds = (unsigned char*)malloc(num_vertices);
+    quadric_t* quadrics = (quadric_t*)calloc(num_vertices, sizeof(quadric_t));
+    edge_set_t edges;
+    edge_set_init(&edges, num_indices);
+
+    build_position_remap(vertices, num_vertices, position_of, next_wedge);
+    find_open_edges(destination, num_indices, num_vertices, &edges, open_out, open_in);
+    classify_vertices(destination, num_indices, num_vertices, position_of, next_wedge, open_out, open_in, kinds);
+
+    // Every vertex starts with the triangles around it, weighted by their area,
+    // and the vertices on borders and seams with a plane across each open edge too,
+    // standing up on the triangle, which keeps them on the border line
+    for (int i = 0; i < num_indices; i += 3)
+    {
+        const uint32_t* triangle = &destination[i];
+        double points[3][QUADRIC_SIZE];
+        for (int k = 0; k < 3; k++)
+            vertex_point(points[k], vertices, texcoords, triangle[k], texcoord_scale);
+
+        vec3_t a = vertices[triangle[0]];
+        vec3_t normal = vec3_cross(vec3_sub(vertices[triangle[1]], a), vec3_sub(vertices[triangle[2]], a));
+        double area = 0.5 * vec3_length(normal);
+        for (int k = 0; k < 3; k++)
+            quadric_add_triangle(&quadrics[triangle[k]], points[0], points[1], points[2], area);
+
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t from = triangle[k];
+            uint32_t to = triangle[(k + 1) % 3];
+            if (edge_set_contains(&edges, to, from))
+                continue;
+
+            vec3_t edge = vec3_sub(vertices[to], vertices[from]);
+            vec3_t edge_normal = vec3_cross(edge, normal);
+            float length = vec3_length(edge_normal);
+            if (length == 0)
+                continue;
+            edge_normal = vec3_div(edge_normal, length);
+            float offset = -vec3_dot(edge_normal, vertices[from]);
+            double weight = vec3_dot(edge, edge) * MESH_LOD_BORDER_WEIGHT;
+            quadric_add_plane(&quadrics[from], edge_normal, offset, weight);
+            quadric_add_plane(&quadrics[to], edge_normal, offset, weight);
+        }
+    }
+
+    int* first_triangle = (int*)malloc(sizeof(int) * (num_vertices + 1));
+    int* triangles = (int*)malloc(sizeof(int) * num_indices);
+    collapse_t* collapses = (collapse_t*)malloc(sizeof(collapse_t) * num_indices);
+    uint32_t* collapse_remap = (uint32_t*)malloc(sizeof(uint32_t) * num_vertices);
+    unsigned char* locked = (unsigned char*)malloc(num_vertices);
+
+    simplifier_t s = {
+        vertices, texcoords, texcoord_scale, position_of, next_wedge, kinds,
+        open_out, open_in, quadrics, destination, first_triangle, triangles
+    };
+
+    double max_error = 0;
+    int num_faces = num_indices / 3;
+    int target_faces = target_num_indices / 3;
+    bool first_pass = true;
+    while (num_faces > target_faces)
+    {
+        int current_indices = num_faces * 3;
+        build_vertex_triangles(destination, current_indices, num_vertices, first_triangle, triangles);
+        if (!first_pass)
+            find_open_edges(destination, current_indices, num_vertices, &edges, open_out, open_in);
+        first_pass = false;
+
+        // The cheapest direction of every edge. Inner edges show up in both of their triangles,
+        // only take them from the one where they go from the lower index to the higher one.
+        int num_collapses = 0;
+        for (int i = 0; i < current_indices; i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = destination[i + k];
+                uint32_t b = destination[i + (k + 1) % 3];
+                if (a > b && edge_set_contains(&edges, b, a))
+                    continue;
+
+                double error_ab = collapse_error(&s, a, b);
+                double error_ba = collapse_error(&s, b, a);
+                if (error_ab < 0 && error_ba < 0)
+                    continue;
+
+                collapse_t collapse = { a, b, error_ab };
+                if (error_ab < 0 || (error_ba >= 0 && error_ba < error_ab))
+                {
+                    collapse.v = b;
+                    collapse.u = a;
+                    collapse.error = error_ba;
+                }
+                collapses[num_collapses++] = collapse;
+            }
+        }
+        if (num_collapses == 0)
+            break;
+        qsort(collapses, num_collapses, sizeof(collapse_t), compare_collapses);
+
+        // A collapse removes 2 triangles on a closed surface, so the pass needs about half as many
+        // as there are triangles to go. Anything much worse than the last of those waits for the next pass.
+        int goal = (num_faces - target_faces + 1) / 2;
+        if (goal > num_collapses)
+            goal = num_collapses;
+        double error_limit = collapses[goal - 1].error * 1.5;
+
+        for (int v = 0; v < num_vertices; v++)
+            collapse_remap[v] = (uint32_t)v;
+        memset(locked, 0, num_vertices);
+
+        int removed_faces = 0;
+        int performed = 0;
+        for (int c = 0; c < num_collapses && num_faces - removed_faces > target_faces; c++)
+        {
+            collapse_t collapse = collapses[c];
+            if (collapse.error > error_limit)
+                break;
+
+            uint32_t v = collapse.v;
+            uint32_t u = collapse.u;
+            if (locked[position_of[v]] || locked[position_of[u]])
+                continue;
+
+            bool seam = (kinds[v] == VERTEX_SEAM);
+            uint32_t wedge = next_wedge[v];
+            uint32_t wedge_target = seam ? seam_target(&s, v, u) : NO_VERTEX;
+            if (!collapse_keeps_orientation(&s, v, u) || (seam && !collapse_keeps_orientation(&s, wedge, wedge_target)))
+                continue;
+
+            collapse_remap[v] = u;
+            quadric_add(&quadrics[u], &quadrics[v]);
+            removed_faces += count_shared_triangles(&s, v, u);
+            lock_triangles_around(&s, v, locked);
+            if (seam)
+            {
+                collapse_remap[wedge] = wedge_target;
+                quadric_add(&quadrics[wedge_target], &quadrics[wedge]);
+                removed_faces += count_shared_triangles(&s, wedge, wedge_target);
+                lock_triangles_around(&s, wedge, locked);
+            }
+
+            if (collapse.error > max_error)
+                max_error = collapse.error;
+            performed++;
+        }
+        if (performed == 0)
+            break;
+
+        // Move the collapsed vertices and drop the triangles that lost an edge
+        int write = 0;
+        for (int i = 0; i < current_indices; i += 3)
+        {
+            uint32_t a = collapse_remap[destination[i + 0]];
+            uint32_t b = collapse_remap[destination[i + 1]];
+            uint32_t c = collapse_remap[destination[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            destination[write + 0] = a;
+            destination[write + 1] = b;
+            destination[write + 2] = c;
+            write += 3;
+        }
+        num_faces = write / 3;
+    }
+
+    free(position_of);
+    free(next_wedge);
+    free(open_out);
+    free(open_in);
+    free(kinds);
+    free(quadrics);
+    free(edges.keys);
+    free(first_triangle);
+    free(triangles);
+    free(collapses);
+    free(collapse_remap);
+    free(locked);
+
+    *result_error = (float)sqrt(max_error);
+    return num_faces * 3;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Every level aims at half the faces of the one before, but is simplified from the full detail faces,
+// so the errors don't pile up from level to level
+///////////////////////////////////////////////////////////////////////////////
+void generate_mesh_lods(mesh_t* mesh)
+{
+    int num_full_faces = mesh->num_faces;
+    memset(mesh->lods, 0, sizeof(mesh->lods));
+    mesh->lods[0].num_faces = num_full_faces;
+    mesh->num_lods = 1;
+
+    uint32_t* lod_indices = (uint32_t*)malloc(sizeof(uint32_t) * num_full_faces * 3);
+    for (int lod = 1; lod < MESH_MAX_LODS; lod++)
+    {
+        int target_faces = num_full_faces >> lod;
+        if (target_faces < MESH_LOD_MIN_FACES)
+            break;
+
+        float error;
+        int num_indices = simplify_mesh(lod_indices, mesh->indices, num_full_faces * 3,
+            mesh->vertices, mesh->texcoords, mesh->num_vertices, target_faces * 3, &error);
+
+        // Stuck (too many locked vertices), a level that's barely simpler isn't worth the memory
+        mesh_lod_t* previous = &mesh->lods[lod - 1];
+        if (num_indices / 3 > previous->num_faces * MESH_LOD_MIN_REDUCTION)
+            break;
+
+        optimize_vertex_cache(lod_indices, num_indices, mesh->num_vertices);
+
+        mesh_lod_t* level = &mesh->lods[lod];
+        level->first_face = mesh->num_faces;
+        level->num_faces = num_indices / 3;
+        level->error = fmaxf(error, previous->error); // a simpler level is never closer to the full detail one
+        array_push_n(mesh->indices, lod_indices, num_indices);
+        mesh->num_faces += level->num_faces;
+        mesh->num_lods++;
+    }
+    free(lod_indices);
+}
@@ -0,0 +1,34 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <stdint.h>
+#include "vector.h"
+#include "texture.h"
+#include "mesh.h"
+
+// Level of detail generation. Unlike mesh_optimizer.c these change what the mesh looks like:
+// they build coarser versions of it, with fewer triangles, for when it's too small on screen
+// for the full detail to show.
+//
+// The coarser triangles are made of a subset of the original vertices (only the index buffer changes),
+// so all the levels share the same vertex arrays and vertex stream.
+#define MESH_LOD_MIN_FACES 64        // no point in simplifying further than this
+#define MESH_LOD_MIN_REDUCTION 0.75f // a level must have at most this fraction of the faces of the previous one
+#define MESH_LOD_TEXCOORD_WEIGHT 1.0f // how far (in mesh sizes) moving the texture by its whole size counts for
+#define MESH_LOD_BORDER_WEIGHT 10.0f  // how much harder borders and UV seams resist changing shape
+
+// Simplify the triangles in indices down to about target_num_indices indices, by edge collapses
+// in the order of their quadric error (Garland and Heckbert), with the texture coordinates
+// in the quadrics too so the texture doesn't slide around on the surface.
+// Vertices on open borders and UV seams only ever move along them, so seams stay closed.
+// Writes the new index buffer to destination (room for num_indices) and returns its size.
+// result_error is the largest distance (in object space) from the original surface a collapse introduced.
+int simplify_mesh(uint32_t* destination, const uint32_t* indices, int num_indices,
+    const vec3_t* vertices, const tex2_t* texcoords, int num_vertices, int target_num_indices, float* result_error);
+
+// Append up to MESH_MAX_LODS - 1 levels of detail to the mesh index buffer, each about half
+// the faces of the previous one, and fill mesh->lods.
+// Runs at load time after optimize_mesh, on a mesh with array.h arrays (not a mapped cache file).
+void generate_mesh_lods(mesh_t* mesh);
+
+#endif
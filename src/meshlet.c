@@ -0,0 +1,118 @@
+#include <math.h>
+#include "meshlet.h"
+
+static vec3_t face_normal(const vec4_t* face_planes, int face)
+{
+    vec3_t normal = { face_planes[face].x, face_planes[face].y, face_planes[face].z };
+    return normal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Bounding sphere, vertex range and normal cone of the faces of a meshlet
+///////////////////////////////////////////////////////////////////////////////
+static void compute_meshlet_bounds(meshlet_t* meshlet, const vec3_t* vertices, const uint32_t* indices, const vec4_t* face_planes)
+{
+    const uint32_t* meshlet_indices = &indices[meshlet->first_face * 3];
+    int num_indices = meshlet->num_faces * 3;
+
+    // Sphere around the center of the bounding box, as big as the furthest vertex
+    vec3_t box_min = vertices[meshlet_indices[0]];
+    vec3_t box_max = box_min;
+    uint32_t min_index = meshlet_indices[0];
+    uint32_t max_index = meshlet_indices[0];
+    for (int i = 1; i < num_indices; i++)
+    {
+        uint32_t index = meshlet_indices[i];
+        vec3_t v = vertices[index];
+        box_min.x = fminf(box_min.x, v.x);
+        box_min.y = fminf(box_min.y, v.y);
+        box_min.z = fminf(box_min.z, v.z);
+        box_max.x = fmaxf(box_max.x, v.x);
+        box_max.y = fmaxf(box_max.y, v.y);
+        box_max.z = fmaxf(box_max.z, v.z);
+        if (index < min_index)
+            min_index = index;
+        if (index > max_index)
+            max_index = index;
+    }
+    meshlet->center = vec3_mul(vec3_add(box_min, box_max), 0.5f);
+    meshlet->radius = 0.0f;
+    for (int i = 0; i < num_indices; i++)
+        meshlet->radius = fmaxf(meshlet->radius, vec3_length(vec3_sub(vertices[meshlet_indices[i]], meshlet->center)));
+    meshlet->first_vertex = (int)min_index;
+    meshlet->end_vertex = (int)max_index + 1;
+
+    // Cone axis: the average normal. Degenerate faces (zero normal) can't be seen from anywhere,
+    // so they don't get a say in the cone.
+    vec3_t axis = { 0, 0, 0 };
+    for (int f = meshlet->first_face; f < meshlet->first_face + meshlet->num_faces; f++)
+        axis = vec3_add(axis, face_normal(face_planes, f));
+    meshlet->cone_axis = axis;
+    meshlet->cone_cutoff = 1.0f;
+    if (vec3_length(axis) == 0.0f)
+        return;
+    vec3_normalize(&meshlet->cone_axis);
+
+    // The cone has to reach the normal furthest from the axis. Past 90 degrees it's no use.
+    float min_dot = 1.0f;
+    for (int f = meshlet->first_face; f < meshlet->first_face + meshlet->num_faces; f++)
+    {
+        vec3_t normal = face_normal(face_planes, f);
+        if (vec3_length(normal) > 0.0f)
+            min_dot = fminf(min_dot, vec3_dot(normal, meshlet->cone_axis));
+    }
+    if (min_dot > 0.0f)
+        meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+meshlet_t* build_meshlets(const vec3_t* vertices, const uint32_t* indices, const vec4_t* face_planes, int first_face, int num_faces, int* num_meshlets, arena_t* arena)
+{
+    // Every meshlet but the last has at least MESHLET_MIN_TRIANGLES faces
+    int max_meshlets = (num_faces + MESHLET_MIN_TRIANGLES - 1) / MESHLET_MIN_TRIANGLES;
+    meshlet_t* meshlets = (meshlet_t*)arena_alloc(arena, sizeof(meshlet_t) * max_meshlets);
+    *num_meshlets = 0;
+    if (meshlets == NULL)
+        return NULL;
+
+    int end_face = first_face + num_faces;
+    while (first_face < end_face)
+    {
+        vec3_t normal_sum = { 0, 0, 0 };
+        int count = 0;
+        while (first_face + count < end_face && count < MESHLET_MAX_TRIANGLES)
+        {
+            vec3_t normal = face_normal(face_planes, first_face + count);
+            if (count >= MESHLET_MIN_TRIANGLES && vec3_length(normal_sum) > 0.0f)
+            {
+                // A face turning away from the rest would widen the cone (and cull it less often)
+                vec3_t axis = normal_sum;
+                vec3_normalize(&axis);
+                if (vec3_dot(normal, axis) < MESHLET_SPLIT_NORMAL_DOT)
+                    break;
+            }
+            normal_sum = vec3_add(normal_sum, normal);
+            count++;
+        }
+
+        meshlet_t* meshlet = &meshlets[*num_meshlets];
+        meshlet->first_face = first_face;
+        meshlet->num_faces = count;
+        compute_meshlet_bounds(meshlet, vertices, indices, face_planes);
+        (*num_meshlets)++;
+        first_face += count;
+    }
+    return meshlets;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// A face is backfacing when the camera is behind its plane, that is when dot(normal, p - camera) > 0
+// for its points p. That holds for every face of the meshlet if the direction from the camera
+// to every point of the bounding sphere is within (90 degrees - cone angle) of the cone axis:
+// dot(center - camera, axis) - radius > sin(cone angle) * (|center - camera| + radius)
+///////////////////////////////////////////////////////////////////////////////
+bool meshlet_is_backfacing(const meshlet_t* meshlet, vec3_t camera_position)
+{
+    vec3_t to_center = vec3_sub(meshlet->center, camera_position);
+    float distance = vec3_length(to_center);
+    return vec3_dot(to_center, meshlet->cone_axis) - meshlet->radius > meshlet->cone_cutoff * (distance + meshlet->radius);
+}
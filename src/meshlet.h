@@ -0,0 +1,42 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vector.h"
+#include "arena.h"
+
+// Meshes are split at load time into clusters of consecutive faces (meshlets),
+// each with the bounds needed to cull it as a whole: a bounding sphere for the frustum,
+// and a cone around the normals of its faces for backface culling.
+// update() culls the meshlets first, and only projects the vertices
+// and walks the faces of the ones that survive.
+//
+// The faces are taken in index buffer order, which the mesh optimizer already made
+// spatially coherent, so consecutive faces make compact clusters.
+// A meshlet closes at MESHLET_MAX_TRIANGLES faces, or earlier (but never before MESHLET_MIN_TRIANGLES)
+// at the first face that points too far away from the average normal so far.
+#define MESHLET_MIN_TRIANGLES 64
+#define MESHLET_MAX_TRIANGLES 128
+#define MESHLET_SPLIT_NORMAL_DOT 0.5f // cos(60 degrees)
+
+typedef struct {
+    int first_face;    // faces first_face to first_face + num_faces - 1 of the mesh
+    int num_faces;
+    int first_vertex;  // the faces only use vertices first_vertex to end_vertex - 1
+    int end_vertex;
+    vec3_t center;     // bounding sphere, in object space
+    float radius;
+    vec3_t cone_axis;  // average direction of the face normals
+    float cone_cutoff; // sine of the angle between the axis and the normal furthest from it, 1 when the cone can't cull
+} meshlet_t;
+
+// Split faces first_face to first_face + num_faces - 1 of the index buffer (one level of detail of a mesh).
+// face_planes are the unit normals (and offsets) of the faces, as built in mesh.c.
+// The meshlets are allocated from arena.
+meshlet_t* build_meshlets(const vec3_t* vertices, const uint32_t* indices, const vec4_t* face_planes, int first_face, int num_faces, int* num_meshlets, arena_t* arena);
+
+// True when every face of the meshlet faces away from camera_position (in object space)
+bool meshlet_is_backfacing(const meshlet_t* meshlet, vec3_t camera_position);
+
+#endif
@@ -0,0 +1,523 @@
+#include <stdio.h>  // for stderr
+#include <limits.h> // for INT_MAX
+#include <stdint.h> // for uint64_t
+#include <string.h> // for memchr
+#include <SDL.h>    // for SDL threads
+#include "array.h"
+#include "file.h"
+#include "obj.h"
+
+// Info regarding .obj line format : https://en.wikipedia.org/wiki/Wavefront_.obj_file
+// reading this will clear things up on why we look for "v ", "vt ", "vn " and "f " lines.
+//
+// The whole file is mapped in memory and scanned twice:
+// the first pass only counts the v/vt/vn lines and the triangles of the f lines,
+// so every array gets allocated once with its exact size,
+// the second pass parses the numbers straight into those arrays.
+// Numbers are parsed by hand instead of sscanf, which is locale-aware and much slower.
+//
+// Big files are split at line boundaries in chunks that are counted and parsed
+// by one thread each. A prefix sum of the per-chunk counts tells every chunk
+// where its elements go in the final arrays (and how many elements come before it,
+// to resolve negative indices), so the chunks are parsed in place with no copying.
+
+enum obj_line_type
+{
+    OBJ_LINE_OTHER, // comments, empty lines, and everything we don't care about (o, g, s, usemtl, mtllib...)
+    OBJ_LINE_VERTEX,
+    OBJ_LINE_TEXCOORD,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE
+};
+
+typedef struct {
+    int num_vertices;
+    int num_texcoords;
+    int num_normals;
+    int num_indices; // 3 per triangle
+} obj_counts_t;
+
+// Files smaller than this are not worth spinning threads for
+#define OBJ_MIN_CHUNK_SIZE (1024 * 1024)
+#define OBJ_MAX_CHUNKS 64
+
+// A range of lines of the file, counted and parsed by its own thread
+typedef struct {
+    const char* data;            // start of the whole file, to report line numbers
+    const char* begin;           // first line of the chunk
+    const char* end;             // one past the last line of the chunk
+    obj_counts_t counts;         // first pass: elements in the chunk, second pass: elements before the chunk
+    const obj_counts_t* total;   // elements in the whole file
+    obj_t* obj;
+    const char* filename;
+    bool success;
+} obj_chunk_t;
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r'; // '\r' so files with Windows line endings work too
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char* skip_blanks(const char* p, const char* end)
+{
+    while (p < end && is_blank(*p))
+        p++;
+    return p;
+}
+
+// Returns a pointer to the start of the next line
+static const char* skip_line(const char* p, const char* end)
+{
+    const char* newline = memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static bool is_end_of_line(const char* p, const char* end)
+{
+    return p >= end || *p == '\n' || *p == '#';
+}
+
+// Find out what the line starting at p is about, and move p past its keyword
+static enum obj_line_type read_line_type(const char** p, const char* end)
+{
+    const char* s = skip_blanks(*p, end);
+    enum obj_line_type type = OBJ_LINE_OTHER;
+    int keyword_length = 0;
+
+    if (end - s >= 2 && s[0] == 'v' && is_blank(s[1])) {
+        type = OBJ_LINE_VERTEX;
+        keyword_length = 1;
+    }
+    else if (end - s >= 3 && s[0] == 'v' && s[1] == 't' && is_blank(s[2])) {
+        type = OBJ_LINE_TEXCOORD;
+        keyword_length = 2;
+    }
+    else if (end - s >= 3 && s[0] == 'v' && s[1] == 'n' && is_blank(s[2])) {
+        type = OBJ_LINE_NORMAL;
+        keyword_length = 2;
+    }
+    else if (end - s >= 2 && s[0] == 'f' && is_blank(s[1])) {
+        type = OBJ_LINE_FACE;
+        keyword_length = 1;
+    }
+
+    *p = s + keyword_length;
+    return type;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parse an integer at p. Returns a pointer past its last digit,
+// or p itself if there was no integer there.
+// Numbers too big for an int saturate to INT_MAX (or -INT_MAX), every digit is still consumed.
+///////////////////////////////////////////////////////////////////////////////
+static const char* parse_int(const char* p, const char* end, int* value)
+{
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p >= end || !is_digit(*p))
+        return start;
+
+    int result = 0;
+    while (p < end && is_digit(*p)) {
+        int digit = *p - '0';
+        result = (result > (INT_MAX - digit) / 10) ? INT_MAX : result * 10 + digit;
+        p++;
+    }
+    *value = negative ? -result : result;
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parse a decimal float (e.g. "-1.25", ".5", "3", "1.0e-3") at p.
+// Returns a pointer past the number, or p itself if there was no number there.
+// The digits are gathered in a 64-bit integer and scaled once by a power of ten,
+// which is plenty precise for 32-bit floats.
+///////////////////////////////////////////////////////////////////////////////
+static const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define MAX_POWER_OF_TEN 22
+#define MAX_MANTISSA_DIGITS 18 // so the mantissa never overflows 64 bits
+
+static const char* parse_float(const char* p, const char* end, float* value)
+{
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int num_digits = 0;       // all digits read
+    int num_kept_digits = 0;  // digits that made it into the mantissa
+    int exponent = 0;
+
+    // integer part
+    for (; p < end && is_digit(*p); p++, num_digits++) {
+        if (num_kept_digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa > 0) num_kept_digits++;
+        }
+        else {
+            exponent++; // digit doesn't fit, but still counts for the magnitude
+        }
+    }
+
+    // fractional part
+    if (p < end && *p == '.') {
+        p++;
+        for (; p < end && is_digit(*p); p++, num_digits++) {
+            if (num_kept_digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa > 0) num_kept_digits++;
+                exponent--;
+            }
+        }
+    }
+
+    if (num_digits == 0)
+        return start;
+
+    // exponent part, only consumed if there are digits after the 'e'
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int exponent_value;
+        const char* after_exponent = parse_int(p + 1, end, &exponent_value);
+        if (after_exponent != p + 1) {
+            // clamp, anything beyond this is 0 or infinity for a float anyway
+            if (exponent_value > 1000) exponent_value = 1000;
+            if (exponent_value < -1000) exponent_value = -1000;
+            exponent += exponent_value;
+            p = after_exponent;
+        }
+    }
+
+    double result = (double)mantissa;
+    if (mantissa != 0) {
+        while (exponent > MAX_POWER_OF_TEN) {
+            result *= powers_of_ten[MAX_POWER_OF_TEN];
+            exponent -= MAX_POWER_OF_TEN;
+        }
+        while (exponent < -MAX_POWER_OF_TEN) {
+            result /= powers_of_ten[MAX_POWER_OF_TEN];
+            exponent += MAX_POWER_OF_TEN;
+        }
+        if (exponent >= 0)
+            result *= powers_of_ten[exponent];
+        else
+            result /= powers_of_ten[-exponent];
+    }
+
+    *value = (float)(negative ? -result : result);
+    return p;
+}
+
+// Line number of position p, only needed to report errors so it's fine to be slow
+static int line_number(const char* data, const char* p)
+{
+    int line = 1;
+    for (const char* c = data; c < p; c++)
+        if (*c == '\n') line++;
+    return line;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert an .obj index to a 0-based index in an array with "count" elements.
+// Positive indices start from 1, negative indices are relative to the
+// elements read so far (-1 is the last one before this face).
+///////////////////////////////////////////////////////////////////////////////
+static bool resolve_index(int index, int count_so_far, int total_count, int* resolved)
+{
+    if (index > 0)
+        *resolved = index - 1;
+    else if (index < 0)
+        *resolved = count_so_far + index;
+    else
+        return false; // 0 is never a valid .obj index
+
+    return *resolved >= 0 && *resolved < total_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parse one face corner in any of the formats v, v/vt, v//vn or v/vt/vn
+///////////////////////////////////////////////////////////////////////////////
+static const char* parse_face_corner(
+    const char* p, const char* end,
+    const obj_counts_t* seen, const obj_counts_t* total,
+    obj_index_t* corner, bool* valid
+) {
+    int v, vt, vn;
+    bool has_vt = false;
+    bool has_vn = false;
+
+    const char* start = p;
+    p = parse_int(p, end, &v);
+    if (p == start) {
+        *valid = false;
+        return p;
+    }
+
+    if (p < end && *p == '/') {
+        p++;
+        const char* vt_start = p;
+        p = parse_int(p, end, &vt);
+        has_vt = (p != vt_start);
+
+        if (p < end && *p == '/') {
+            p++;
+            const char* vn_start = p;
+            p = parse_int(p, end, &vn);
+            has_vn = (p != vn_start);
+        }
+    }
+
+    corner->vt = -1;
+    corner->vn = -1;
+    *valid = resolve_index(v, seen->num_vertices, total->num_vertices, &corner->v)
+        && (!has_vt || resolve_index(vt, seen->num_texcoords, total->num_texcoords, &corner->vt))
+        && (!has_vn || resolve_index(vn, seen->num_normals, total->num_normals, &corner->vn))
+        && (is_end_of_line(p, end) || is_blank(*p)); // no garbage right after the corner
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// First pass: count the elements of each kind, so we can allocate exactly once
+///////////////////////////////////////////////////////////////////////////////
+static void obj_count(const char* begin, const char* end, obj_counts_t* counts)
+{
+    counts->num_vertices = 0;
+    counts->num_texcoords = 0;
+    counts->num_normals = 0;
+    counts->num_indices = 0;
+
+    const char* p = begin;
+    while (p < end)
+    {
+        switch (read_line_type(&p, end))
+        {
+            case OBJ_LINE_VERTEX: counts->num_vertices++; break;
+            case OBJ_LINE_TEXCOORD: counts->num_texcoords++; break;
+            case OBJ_LINE_NORMAL: counts->num_normals++; break;
+            case OBJ_LINE_FACE: {
+                // A face with n corners is split into (n - 2) triangles
+                int num_corners = 0;
+                for (p = skip_blanks(p, end); !is_end_of_line(p, end); p = skip_blanks(p, end)) {
+                    while (p < end && !is_blank(*p) && !is_end_of_line(p, end))
+                        p++;
+                    num_corners++;
+                }
+                if (num_corners >= 3)
+                    counts->num_indices += (num_corners - 2) * 3;
+                break;
+            }
+            default: break;
+        }
+        p = skip_line(p, end);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Second pass: parse every v/vt/vn/f line in the arrays of obj.
+// The "seen" counters say how many elements come before begin
+// (which is also where the parsed elements should be written).
+///////////////////////////////////////////////////////////////////////////////
+static bool obj_parse(
+    const char* data, const char* begin, const char* end,
+    obj_counts_t* seen, const obj_counts_t* total, obj_t* obj,
+    const char* filename
+) {
+    const char* p = begin;
+    while (p < end)
+    {
+        switch (read_line_type(&p, end))
+        {
+            case OBJ_LINE_VERTEX: {
+                vec3_t vertex = { 0, 0, 0 };
+                p = parse_float(skip_blanks(p, end), end, &vertex.x);
+                p = parse_float(skip_blanks(p, end), end, &vertex.y);
+                p = parse_float(skip_blanks(p, end), end, &vertex.z);
+                obj->vertices[seen->num_vertices++] = vertex;
+                break;
+            }
+            case OBJ_LINE_TEXCOORD: {
+                tex2_t texcoord = { 0, 0 };
+                p = parse_float(skip_blanks(p, end), end, &texcoord.u);
+                p = parse_float(skip_blanks(p, end), end, &texcoord.v);
+                obj->texcoords[seen->num_texcoords++] = texcoord;
+                break;
+            }
+            case OBJ_LINE_NORMAL: {
+                vec3_t normal = { 0, 0, 0 };
+                p = parse_float(skip_blanks(p, end), end, &normal.x);
+                p = parse_float(skip_blanks(p, end), end, &normal.y);
+                p = parse_float(skip_blanks(p, end), end, &normal.z);
+                obj->normals[seen->num_normals++] = normal;
+                break;
+            }
+            case OBJ_LINE_FACE: {
+                // Triangulate quads and n-gons as a fan around the first corner
+                // (0,1,2), (0,2,3), (0,3,4)... keeping the winding order of the file
+                obj_index_t first = { 0, -1, -1 };
+                obj_index_t previous = first;
+                obj_index_t corner;
+                int num_corners = 0;
+                for (p = skip_blanks(p, end); !is_end_of_line(p, end); p = skip_blanks(p, end)) {
+                    bool valid;
+                    p = parse_face_corner(p, end, seen, total, &corner, &valid);
+                    if (!valid) {
+                        fprintf(stderr, "Error in %s line %d: invalid face.\n", filename, line_number(data, p));
+                        return false;
+                    }
+                    if (num_corners >= 2) {
+                        obj->indices[seen->num_indices++] = first;
+                        obj->indices[seen->num_indices++] = previous;
+                        obj->indices[seen->num_indices++] = corner;
+                    }
+                    if (num_corners == 0)
+                        first = corner;
+                    previous = corner;
+                    num_corners++;
+                }
+                break;
+            }
+            default: break;
+        }
+        p = skip_line(p, end);
+    }
+    return true;
+}
+
+// array_hold with a NULL array allocates an array of exactly count elements
+static void* allocate_array(size_t count, size_t item_size)
+{
+    return count > 0 ? array_hold(NULL, count, item_size) : NULL;
+}
+
+static int SDLCALL obj_count_chunk(void* data)
+{
+    obj_chunk_t* chunk = (obj_chunk_t*)data;
+    obj_count(chunk->begin, chunk->end, &chunk->counts);
+    return 0;
+}
+
+static int SDLCALL obj_parse_chunk(void* data)
+{
+    obj_chunk_t* chunk = (obj_chunk_t*)data;
+    chunk->success = obj_parse(chunk->data, chunk->begin, chunk->end, &chunk->counts, chunk->total, chunk->obj, chunk->filename);
+    return 0;
+}
+
+// Run function on every chunk, each one in its own thread (the first one in the calling thread)
+static void run_chunks(obj_chunk_t* chunks, int num_chunks, SDL_ThreadFunction function)
+{
+    SDL_Thread* threads[OBJ_MAX_CHUNKS] = { NULL };
+    for (int i = 1; i < num_chunks; i++)
+        threads[i] = SDL_CreateThread(function, "obj_chunk", &chunks[i]);
+
+    function(&chunks[0]);
+
+    for (int i = 1; i < num_chunks; i++) {
+        if (threads[i] != NULL)
+            SDL_WaitThread(threads[i], NULL);
+        else
+            function(&chunks[i]); // couldn't get a thread, do it ourselves
+    }
+}
+
+// Split the file in chunks of whole lines, one per CPU core as long as chunks are big enough
+static int split_in_chunks(const char* data, size_t size, obj_chunk_t* chunks)
+{
+    size_t num_chunks = size / OBJ_MIN_CHUNK_SIZE;
+    size_t num_cores = (size_t)SDL_GetCPUCount();
+    if (num_chunks > num_cores) num_chunks = num_cores;
+    if (num_chunks > OBJ_MAX_CHUNKS) num_chunks = OBJ_MAX_CHUNKS;
+    if (num_chunks < 1) num_chunks = 1;
+
+    const char* end = data + size;
+    const char* chunk_begin = data;
+    for (size_t i = 0; i < num_chunks; i++) {
+        // Move the split point forward to the start of the next line
+        const char* chunk_end = end;
+        if (i < num_chunks - 1) {
+            chunk_end = data + size / num_chunks * (i + 1);
+            chunk_end = (chunk_end > chunk_begin) ? skip_line(chunk_end - 1, end) : chunk_begin;
+        }
+        chunks[i].data = data;
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+    return (int)num_chunks;
+}
+
+bool obj_load(const char* filename, obj_t* obj)
+{
+    obj->vertices = NULL;
+    obj->texcoords = NULL;
+    obj->normals = NULL;
+    obj->indices = NULL;
+
+    mapped_file_t file;
+    if (!map_file(filename, &file))
+        return false;
+
+    obj_chunk_t chunks[OBJ_MAX_CHUNKS];
+    int num_chunks = split_in_chunks(file.data, file.size, chunks);
+
+    // First pass: count the elements of every chunk
+    run_chunks(chunks, num_chunks, obj_count_chunk);
+
+    // Prefix sum: each chunk starts writing where the previous chunks end
+    obj_counts_t total = { 0, 0, 0, 0 };
+    for (int i = 0; i < num_chunks; i++) {
+        obj_counts_t chunk_counts = chunks[i].counts;
+        chunks[i].counts = total;
+        chunks[i].total = &total;
+        chunks[i].obj = obj;
+        chunks[i].filename = filename;
+        total.num_vertices += chunk_counts.num_vertices;
+        total.num_texcoords += chunk_counts.num_texcoords;
+        total.num_normals += chunk_counts.num_normals;
+        total.num_indices += chunk_counts.num_indices;
+    }
+
+    obj->vertices = allocate_array(total.num_vertices, sizeof(vec3_t));
+    obj->texcoords = allocate_array(total.num_texcoords, sizeof(tex2_t));
+    obj->normals = allocate_array(total.num_normals, sizeof(vec3_t));
+    obj->indices = allocate_array(total.num_indices, sizeof(obj_index_t));
+
+    // Second pass: parse every chunk straight into its part of the arrays
+    run_chunks(chunks, num_chunks, obj_parse_chunk);
+
+    unmap_file(&file);
+
+    bool success = true;
+    for (int i = 0; i < num_chunks; i++)
+        success = success && chunks[i].success;
+
+    if (!success)
+        obj_free(obj);
+    return success;
+}
+
+void obj_free(obj_t* obj)
+{
+    array_free(obj->vertices);
+    array_free(obj->texcoords);
+    array_free(obj->normals);
+    array_free(obj->indices);
+    obj->vertices = NULL;
+    obj->texcoords = NULL;
+    obj->normals = NULL;
+    obj->indices = NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef OBJ_H
+#define OBJ_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "texture.h"
+
+// Indices of one face corner into the v, vt and vn arrays of the .obj file.
+// Already converted to 0-based indices, -1 when the corner doesn't reference one
+// (e.g. "f 1 2 3" has neither UVs nor normals, "f 1//1 2//2 3//3" has no UVs)
+typedef struct {
+    int v;
+    int vt;
+    int vn;
+} obj_index_t;
+
+// Everything we read from an .obj file, all of them are array.h dynamic arrays
+typedef struct {
+    vec3_t* vertices;     // v lines
+    tex2_t* texcoords;    // vt lines
+    vec3_t* normals;      // vn lines
+    obj_index_t* indices; // 3 corners per triangle (quads and n-gons are already triangulated)
+} obj_t;
+
+bool obj_load(const char* filename, obj_t* obj);
+void obj_free(obj_t* obj);
+
+#endif
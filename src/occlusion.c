@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h> // for SDL_HasAVX2 and SDL_AtomicGet
+#include "occlusion.h"
+
+// Same as in vertex_stream.c: the AVX2 version is compiled for those functions only, and picked at runtime
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define OCCLUSION_AVX2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+#endif
+
+bool occlusion_culling = true;
+
+// 1 / w of the nearest occluder surface in every pixel (0: nothing there)
+static float occlusion_buffer[OCCLUSION_HEIGHT][OCCLUSION_WIDTH];
+
+// An occluder triangle ready for rasterization: 3 edge functions and the 1 / w plane, all as
+// a * x + b * y + c at pixel centers. A pixel is entirely inside an edge when the function is at least
+// threshold at its center (half the change of the function across the pixel, towards its worst corner).
+typedef struct {
+    float edge_a[3], edge_b[3], edge_c[3], edge_threshold[3];
+    float depth_a, depth_b, depth_c;
+    float depth_offset; // half the change of 1 / w across a pixel, towards its furthest corner
+    float min_depth;    // smallest 1 / w of the 3 vertices, nothing inside can be further
+    int x0, x1, y0, y1; // pixels to look at, x0 and x1 multiples of 8 (rows are scanned 8 pixels at a time)
+} occluder_triangle_t;
+
+///////////////////////////////////////////////////////////////////////////////
+// Row rasterization, 8 pixels at a time.
+// Both versions do the same float operations in the same order, so they write the same depths.
+///////////////////////////////////////////////////////////////////////////////
+static void rasterize_triangle_scalar(const occluder_triangle_t* t)
+{
+    for (int y = t->y0; y < t->y1; y++)
+    {
+        float center_y = y + 0.5f;
+        float* row = occlusion_buffer[y];
+        for (int x = t->x0; x < t->x1; x++)
+        {
+            float center_x = x + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+                inside &= (t->edge_a[e] * center_x + t->edge_b[e] * center_y + t->edge_c[e]) >= t->edge_threshold[e];
+            if (!inside)
+                continue;
+            float depth = fmaxf((t->depth_a * center_x + t->depth_b * center_y + t->depth_c) - t->depth_offset, t->min_depth);
+            row[x] = fmaxf(row[x], depth);
+        }
+    }
+}
+
+#ifdef OCCLUSION_AVX2
+AVX2_FUNCTION static void rasterize_triangle_avx2(const occluder_triangle_t* t)
+{
+    const __m256 lane_offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    for (int y = t->y0; y < t->y1; y++)
+    {
+        __m256 center_y = _mm256_set1_ps(y + 0.5f);
+        float* row = occlusion_buffer[y];
+        for (int x = t->x0; x < t->x1; x += 8)
+        {
+            __m256 center_x = _mm256_add_ps(_mm256_set1_ps((float)x), lane_offsets);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int e = 0; e < 3; e++)
+            {
+                __m256 edge = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(t->edge_a[e]), center_x),
+                    _mm256_mul_ps(_mm256_set1_ps(t->edge_b[e]), center_y)),
+                    _mm256_set1_ps(t->edge_c[e]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, _mm256_set1_ps(t->edge_threshold[e]), _CMP_GE_OQ));
+            }
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+
+            __m256 depth = _mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(t->depth_a), center_x),
+                _mm256_mul_ps(_mm256_set1_ps(t->depth_b), center_y)),
+                _mm256_set1_ps(t->depth_c));
+            depth = _mm256_max_ps(_mm256_sub_ps(depth, _mm256_set1_ps(t->depth_offset)), _mm256_set1_ps(t->min_depth));
+            __m256 stored = _mm256_loadu_ps(&row[x]);
+            _mm256_storeu_ps(&row[x], _mm256_blendv_ps(stored, _mm256_max_ps(stored, depth), inside));
+        }
+    }
+}
+#endif
+
+static bool use_avx2(void)
+{
+#ifdef OCCLUSION_AVX2
+    static SDL_atomic_t has_avx2 = { -1 }; // asking the CPU every frame is not free, ask once
+    if (SDL_AtomicGet(&has_avx2) < 0)
+        SDL_AtomicSet(&has_avx2, SDL_HasAVX2() ? 1 : 0);
+    return SDL_AtomicGet(&has_avx2) == 1;
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Occluders
+///////////////////////////////////////////////////////////////////////////////
+// Vertices are (screen x, screen y, z / w, w) in the occlusion buffer, as project_vertex_stream gives them
+static void rasterize_occluder_triangle(vec4_t v0, vec4_t v1, vec4_t v2)
+{
+    // Reaching behind the near plane, the screen positions mean nothing: don't occlude anything with it
+    if (v0.w <= 0.0f || v1.w <= 0.0f || v2.w <= 0.0f || v0.z < 0.0f || v1.z < 0.0f || v2.z < 0.0f)
+        return;
+
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area == 0.0f)
+        return;
+
+    occluder_triangle_t t;
+    float min_x = fminf(v0.x, fminf(v1.x, v2.x));
+    float max_x = fmaxf(v0.x, fmaxf(v1.x, v2.x));
+    float min_y = fminf(v0.y, fminf(v1.y, v2.y));
+    float max_y = fmaxf(v0.y, fmaxf(v1.y, v2.y));
+    t.x0 = (min_x > 0.0f) ? ((int)min_x & ~7) : 0;
+    t.y0 = (min_y > 0.0f) ? (int)min_y : 0;
+    t.x1 = (max_x < OCCLUSION_WIDTH) ? (((int)ceilf(max_x) + 7) & ~7) : OCCLUSION_WIDTH;
+    t.y1 = (max_y < OCCLUSION_HEIGHT) ? (int)ceilf(max_y) : OCCLUSION_HEIGHT;
+    if (t.x0 >= t.x1 || t.y0 >= t.y1)
+        return;
+
+    // Edge i goes from vertex i to vertex i + 1, and is positive on the side of the third vertex
+    // whichever way the triangle winds (occluders hide what's behind them from either side)
+    vec4_t v[3] = { v0, v1, v2 };
+    float sign = (area > 0.0f) ? 1.0f : -1.0f;
+    for (int e = 0; e < 3; e++)
+    {
+        vec4_t a = v[e];
+        vec4_t b = v[(e + 1) % 3];
+        t.edge_a[e] = sign * (a.y - b.y);
+        t.edge_b[e] = sign * (b.x - a.x);
+        t.edge_c[e] = sign * (a.x * b.y - a.y * b.x);
+        t.edge_threshold[e] = 0.5f * (fabsf(t.edge_a[e]) + fabsf(t.edge_b[e]));
+    }
+
+    // 1 / w interpolates linearly across the screen: solve its plane from the 3 vertices
+    float d0 = 1.0f / v0.w, d1 = 1.0f / v1.w, d2 = 1.0f / v2.w;
+    t.depth_a = ((d1 - d0) * (v2.y - v0.y) - (d2 - d0) * (v1.y - v0.y)) / area;
+    t.depth_b = ((d2 - d0) * (v1.x - v0.x) - (d1 - d0) * (v2.x - v0.x)) / area;
+    t.depth_c = d0 - t.depth_a * v0.x - t.depth_b * v0.y;
+    t.depth_offset = 0.5f * (fabsf(t.depth_a) + fabsf(t.depth_b));
+    t.min_depth = fminf(d0, fminf(d1, d2));
+
+#ifdef OCCLUSION_AVX2
+    if (use_avx2())
+    {
+        rasterize_triangle_avx2(&t);
+        return;
+    }
+#endif
+    rasterize_triangle_scalar(&t);
+}
+
+// Always the full detail faces: the error of the simpler levels is an average, not a bound,
+// so their surface can reach past the real one and hide instances that can be seen
+static void rasterize_occluder(const mesh_instance_t* instance, arena_t* arena)
+{
+    const mesh_t* mesh = instance->mesh;
+    const mesh_lod_t* lod = &mesh->lods[0];
+    vec4_t* projected_vertices = (vec4_t*)arena_alloc(arena, sizeof(vec4_t) * mesh->vertex_stream.padded_count);
+    if (projected_vertices == NULL)
+        return;
+    project_vertex_stream(&mesh->vertex_stream, &instance->transform.world_view_proj_matrix,
+        OCCLUSION_WIDTH, OCCLUSION_HEIGHT, projected_vertices);
+
+    for (int f = lod->first_face; f < lod->first_face + lod->num_faces; f++)
+    {
+        const uint32_t* face_indices = &mesh->indices[f * 3];
+        rasterize_occluder_triangle(projected_vertices[face_indices[0]], projected_vertices[face_indices[1]], projected_vertices[face_indices[2]]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Occludees
+///////////////////////////////////////////////////////////////////////////////
+// Screen rectangle of a bounding box in the occlusion buffer (pixels x0 to x1 - 1, y0 to y1 - 1),
+// and the 1 / w of its nearest point. False when the box reaches behind the near plane.
+typedef struct {
+    int x0, x1, y0, y1;
+    float max_depth;
+} screen_box_t;
+
+static bool project_box(const mat4_t* view_proj_matrix, vec3_t box_min, vec3_t box_max, screen_box_t* screen_box)
+{
+    float min_x = OCCLUSION_WIDTH, max_x = 0.0f;
+    float min_y = OCCLUSION_HEIGHT, max_y = 0.0f;
+    screen_box->max_depth = 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec4_t point = {
+            (corner & 1) ? box_max.x : box_min.x,
+            (corner & 2) ? box_max.y : box_min.y,
+            (corner & 4) ? box_max.z : box_min.z,
+            1.0f
+        };
+        vec4_t clip = mat4_mul_vec4(*view_proj_matrix, point);
+        if (clip.w <= 0.0f || clip.z < 0.0f)
+            return false;
+
+        // Same viewport mapping as the vertex stream kernels, y flipped
+        float inverse_w = 1.0f / clip.w;
+        float x = (clip.x * inverse_w) * (OCCLUSION_WIDTH / 2.0f) + (OCCLUSION_WIDTH / 2.0f);
+        float y = (clip.y * inverse_w) * -(OCCLUSION_HEIGHT / 2.0f) + (OCCLUSION_HEIGHT / 2.0f);
+        min_x = fminf(min_x, x);
+        max_x = fmaxf(max_x, x);
+        min_y = fminf(min_y, y);
+        max_y = fmaxf(max_y, y);
+        screen_box->max_depth = fmaxf(screen_box->max_depth, inverse_w);
+    }
+    screen_box->x0 = (min_x > 0.0f) ? (int)min_x : 0;
+    screen_box->y0 = (min_y > 0.0f) ? (int)min_y : 0;
+    screen_box->x1 = (max_x < OCCLUSION_WIDTH) ? (int)ceilf(max_x) : OCCLUSION_WIDTH;
+    screen_box->y1 = (max_y < OCCLUSION_HEIGHT) ? (int)ceilf(max_y) : OCCLUSION_HEIGHT;
+    return true;
+}
+
+// Hidden when every pixel it touches has an occluder in front of its nearest point
+static bool screen_box_occluded(const screen_box_t* screen_box)
+{
+    for (int y = screen_box->y0; y < screen_box->y1; y++)
+    {
+        for (int x = screen_box->x0; x < screen_box->x1; x++)
+        {
+            if (occlusion_buffer[y][x] <= screen_box->max_depth)
+                return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Occluders go nearest first, only the big ones are worth it.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int visible_index; // in visible_instances
+    float depth;       // 1 / w of the nearest point of the box
+} occluder_candidate_t;
+
+static int compare_occluders_by_depth(const void* a, const void* b)
+{
+    float depth_a = ((const occluder_candidate_t*)a)->depth;
+    float depth_b = ((const occluder_candidate_t*)b)->depth;
+    if (depth_a != depth_b)
+        return (depth_a > depth_b) ? -1 : 1;
+    return ((const occluder_candidate_t*)a)->visible_index - ((const occluder_candidate_t*)b)->visible_index;
+}
+
+int cull_occluded_instances(const scene_t* scene, int* visible_instances, int num_visible_instances,
+    const mat4_t* view_proj_matrix, arena_t* arena)
+{
+    screen_box_t* screen_boxes = (screen_box_t*)arena_alloc(arena, sizeof(screen_box_t) * num_visible_instances);
+    bool* in_front = (bool*)arena_alloc(arena, sizeof(bool) * num_visible_instances);
+    occluder_candidate_t* candidates = (occluder_candidate_t*)arena_alloc(arena, sizeof(occluder_candidate_t) * num_visible_instances);
+    if (screen_boxes == NULL || in_front == NULL || candidates == NULL)
+        return num_visible_instances;
+
+    int num_candidates = 0;
+    for (int i = 0; i < num_visible_instances; i++)
+    {
+        const mesh_instance_t* instance = &scene->instances[visible_instances[i]];
+        in_front[i] = project_box(view_proj_matrix, instance->bounds_min, instance->bounds_max, &screen_boxes[i]);
+        int width = screen_boxes[i].x1 - screen_boxes[i].x0;
+        int height = screen_boxes[i].y1 - screen_boxes[i].y0;
+        if (in_front[i] && (width >= OCCLUSION_MIN_OCCLUDER_SIZE || height >= OCCLUSION_MIN_OCCLUDER_SIZE))
+        {
+            candidates[num_candidates].visible_index = i;
+            candidates[num_candidates].depth = screen_boxes[i].max_depth;
+            num_candidates++;
+        }
+    }
+    if (num_candidates == 0)
+        return num_visible_instances;
+    qsort(candidates, num_candidates, sizeof(occluder_candidate_t), compare_occluders_by_depth);
+
+    memset(occlusion_buffer, 0, sizeof(occlusion_buffer));
+    int num_occluders = (num_candidates < OCCLUSION_MAX_OCCLUDERS) ? num_candidates : OCCLUSION_MAX_OCCLUDERS;
+    for (int i = 0; i < num_occluders; i++)
+    {
+        const mesh_instance_t* instance = &scene->instances[visible_instances[candidates[i].visible_index]];
+        rasterize_occluder(instance, arena);
+    }
+
+    // Keep the ones that can still be seen, in the same order
+    int num_kept = 0;
+    for (int i = 0; i < num_visible_instances; i++)
+    {
+        if (in_front[i] && screen_box_occluded(&screen_boxes[i]))
+            continue;
+        visible_instances[num_kept++] = visible_instances[i];
+    }
+    return num_kept;
+}
@@ -0,0 +1,35 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+#include "matrix.h"
+#include "arena.h"
+#include "scene.h"
+
+// Software occlusion culling, in the spirit of Masked Occlusion Culling (Hasselgren et al.):
+// the biggest instances on screen (the occluders) are rasterized into a small depth buffer first,
+// then the screen rectangle of every visible instance is checked against it, and the ones behind
+// the occluders everywhere in their rectangle are dropped before their vertices are even transformed.
+//
+// Everything errs on the side of visible, so nothing that should be seen ever goes missing:
+// - occluder triangles only cover the pixels they cover entirely (inner conservative rasterization),
+//   and each pixel stores the furthest depth the triangle has inside of it
+// - instances are tested with their whole bounding box: its nearest depth against every pixel it touches
+// - triangles and boxes reaching behind the near plane don't occlude, and are never occluded
+//
+// Depths are stored as 1 / w (w is the camera space depth), which is linear in screen space
+// and doesn't need a divide per pixel: bigger is nearer, 0 is infinitely far away.
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_MAX_OCCLUDERS 16         // nearest instances to rasterize, out of the ones big enough
+#define OCCLUSION_MIN_OCCLUDER_SIZE 16     // pixels of the occlusion buffer an occluder's box must span at least (width or height)
+
+extern bool occlusion_culling; // on by default, toggled with the O key
+
+// Keep only the instances (of the visible_instances indices) that aren't hidden behind the biggest of them,
+// and return how many are left. view_proj_matrix takes world space to clip space.
+// Scratch memory comes from arena.
+int cull_occluded_instances(const scene_t* scene, int* visible_instances, int num_visible_instances,
+    const mat4_t* view_proj_matrix, arena_t* arena);
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "file.h"
+#include "resource_cache.h"
+
+resource_cache_t resource_cache = { NULL, NULL };
+
+void resource_cache_init(resource_cache_t* cache)
+{
+    cache->resources = NULL;
+    cache->mutex = SDL_CreateMutex();
+    if (cache->mutex == NULL)
+        fprintf(stderr, "Error creating the resource cache mutex: %s\n", SDL_GetError());
+}
+
+// The handles given out are the mesh or texture inside a resource
+static resource_t* resource_of_mesh(const mesh_t* mesh)
+{
+    return (resource_t*)((char*)mesh - offsetof(resource_t, mesh));
+}
+
+static resource_t* resource_of_texture(const texture_t* texture)
+{
+    return (resource_t*)((char*)texture - offsetof(resource_t, texture));
+}
+
+// Call with the mutex locked
+static resource_t* find_by_path(resource_cache_t* cache, resource_type_t type, const char* path, uint64_t file_size, int64_t file_time)
+{
+    for (size_t i = 0; i < array_length(cache->resources); i++)
+    {
+        resource_t* resource = cache->resources[i];
+        if (resource->type == type && resource->file_size == file_size && resource->file_time == file_time &&
+            strcmp(resource->path, path) == 0)
+            return resource;
+    }
+    return NULL;
+}
+
+static void destroy_resource(resource_t* resource)
+{
+    if (resource->type == RESOURCE_MESH)
+        free_mesh(&resource->mesh);
+    arena_free(&resource->arena);
+    free(resource);
+}
+
+static void release(resource_cache_t* cache, resource_t* resource)
+{
+    SDL_LockMutex(cache->mutex);
+    bool is_last = (--resource->ref_count == 0);
+    if (is_last)
+    {
+        size_t count = array_length(cache->resources);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (cache->resources[i] == resource)
+            {
+                cache->resources[i] = cache->resources[count - 1];
+                array_resize(cache->resources, count - 1);
+                break;
+            }
+        }
+    }
+    SDL_UnlockMutex(cache->mutex);
+
+    if (is_last)
+        destroy_resource(resource);
+}
+
+// Whether the file of a resource is still the one it was loaded from
+static bool resource_file_unchanged(const resource_t* resource)
+{
+    uint64_t file_size;
+    int64_t file_time;
+    return file_info(resource->path, &file_size, &file_time) && file_size == resource->file_size && file_time == resource->file_time;
+}
+
+// The hash of the contents of a resource, computed the first time somebody needs it.
+// False when its file changed since it was loaded, that hash wouldn't be the one of the resource.
+static bool resource_content_hash(resource_cache_t* cache, resource_t* resource, uint64_t* content_hash)
+{
+    SDL_LockMutex(cache->mutex);
+    bool has_content_hash = resource->has_content_hash;
+    *content_hash = resource->content_hash;
+    SDL_UnlockMutex(cache->mutex);
+    if (has_content_hash)
+        return true;
+
+    if (!resource_file_unchanged(resource) || !file_hash(resource->path, content_hash))
+        return false;
+    SDL_LockMutex(cache->mutex);
+    resource->content_hash = *content_hash;
+    resource->has_content_hash = true;
+    SDL_UnlockMutex(cache->mutex);
+    return true;
+}
+
+// A loaded resource with the same contents as the file at path (with one more reference to it), or NULL.
+// Only files of the same size can match, so the file is only hashed (in content_hash) when there are some.
+// Hashes can collide, so a match is only shared once the bytes of both files compare equal.
+static resource_t* acquire_same_contents(resource_cache_t* cache, resource_type_t type, const char* path,
+    uint64_t file_size, uint64_t* content_hash, bool* has_content_hash)
+{
+    // Every candidate gets a reference, so none goes away while its file is looked at
+    resource_t** candidates = NULL;
+    SDL_LockMutex(cache->mutex);
+    for (size_t i = 0; i < array_length(cache->resources); i++)
+    {
+        resource_t* resource = cache->resources[i];
+        if (resource->type == type && resource->file_size == file_size)
+        {
+            resource->ref_count++;
+            array_push(candidates, resource);
+        }
+    }
+    SDL_UnlockMutex(cache->mutex);
+
+    resource_t* found = NULL;
+    for (size_t i = 0; i < array_length(candidates); i++)
+    {
+        resource_t* candidate = candidates[i];
+        if (found == NULL && !*has_content_hash)
+            *has_content_hash = file_hash(path, content_hash);
+
+        uint64_t candidate_hash;
+        if (found == NULL && *has_content_hash &&
+            resource_content_hash(cache, candidate, &candidate_hash) && candidate_hash == *content_hash &&
+            resource_file_unchanged(candidate) && same_file_contents(path, candidate->path))
+            found = candidate;
+        else
+            release(cache, candidate);
+    }
+    array_free(candidates);
+    return found;
+}
+
+static resource_t* acquire(resource_cache_t* cache, resource_type_t type, const char* filename)
+{
+    char path[RESOURCE_MAX_PATH];
+    uint64_t file_size;
+    int64_t file_time;
+    if (!canonical_path(filename, path, sizeof(path)) || !file_info(path, &file_size, &file_time))
+    {
+        fprintf(stderr, "Error opening file %s.\n", filename);
+        return NULL;
+    }
+
+    // The file itself, unchanged since it was loaded
+    SDL_LockMutex(cache->mutex);
+    resource_t* resource = find_by_path(cache, type, path, file_size, file_time);
+    if (resource != NULL)
+        resource->ref_count++;
+    SDL_UnlockMutex(cache->mutex);
+    if (resource != NULL)
+        return resource;
+
+    // The same contents under another name
+    uint64_t content_hash = 0;
+    bool has_content_hash = false;
+    resource = acquire_same_contents(cache, type, path, file_size, &content_hash, &has_content_hash);
+    if (resource != NULL)
+        return resource;
+
+    resource = (resource_t*)calloc(1, sizeof(resource_t));
+    if (resource == NULL)
+        return NULL;
+    resource->type = type;
+    strcpy(resource->path, path);
+    resource->file_size = file_size;
+    resource->file_time = file_time;
+    resource->content_hash = content_hash;
+    resource->has_content_hash = has_content_hash;
+    resource->ref_count = 1;
+
+    bool is_loaded = (type == RESOURCE_MESH) ?
+        load_obj_file_data(&resource->mesh, filename, &resource->arena) :
+        load_png_texture_data(&resource->texture, filename, &resource->arena);
+    if (!is_loaded)
+    {
+        destroy_resource(resource);
+        return NULL;
+    }
+    resource->size = resource->arena.used + resource->mesh.cache_file.size;
+
+    // Another thread may have loaded the same file in the meantime
+    SDL_LockMutex(cache->mutex);
+    resource_t* loaded = find_by_path(cache, type, path, file_size, file_time);
+    if (loaded != NULL)
+        loaded->ref_count++;
+    else
+        array_push(cache->resources, resource);
+    SDL_UnlockMutex(cache->mutex);
+
+    if (loaded == NULL)
+        return resource;
+    destroy_resource(resource);
+    return loaded;
+}
+
+mesh_t* resource_acquire_mesh(resource_cache_t* cache, const char* filename)
+{
+    resource_t* resource = acquire(cache, RESOURCE_MESH, filename);
+    return (resource != NULL) ? &resource->mesh : NULL;
+}
+
+texture_t* resource_acquire_texture(resource_cache_t* cache, const char* filename)
+{
+    resource_t* resource = acquire(cache, RESOURCE_TEXTURE, filename);
+    return (resource != NULL) ? &resource->texture : NULL;
+}
+
+void resource_release_mesh(resource_cache_t* cache, mesh_t* mesh)
+{
+    release(cache, resource_of_mesh(mesh));
+}
+
+void resource_release_texture(resource_cache_t* cache, texture_t* texture)
+{
+    release(cache, resource_of_texture(texture));
+}
+
+size_t resource_mesh_size(const mesh_t* mesh)
+{
+    return resource_of_mesh(mesh)->size;
+}
+
+size_t resource_texture_size(const texture_t* texture)
+{
+    return resource_of_texture(texture)->size;
+}
+
+void resource_cache_free(resource_cache_t* cache)
+{
+    for (size_t i = 0; i < array_length(cache->resources); i++)
+        destroy_resource(cache->resources[i]);
+    array_free(cache->resources);
+    cache->resources = NULL;
+    SDL_DestroyMutex(cache->mutex);
+    cache->mutex = NULL;
+}
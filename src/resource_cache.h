@@ -0,0 +1,67 @@
+#ifndef RESOURCE_CACHE_H
+#define RESOURCE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL.h>    // for SDL_mutex
+#include "mesh.h"
+#include "texture.h"
+#include "arena.h"
+
+// Meshes and textures shared by everything that loads the same file: asking for one that's already loaded
+// hands out the one in memory with one more reference to it, instead of parsing or decoding it again.
+//
+// The same file is one with the same canonical path (see canonical_path in file.h) that still has the size
+// and modification time it had when it was loaded, or else a copy of a loaded file under another name:
+// same size, same hash of the contents, and the same bytes when both files are compared.
+// Files are only hashed when a loaded one of the same type has the same size, so most loads read their file once.
+// Every mesh or texture has an arena of its own, freed when the last reference to it is released.
+//
+// Safe to use from any thread. The cache is only locked to look things up, never while a file loads,
+// so when two threads load the same file at once the first to finish keeps it and the other copy is dropped
+// (two copies of a file under different names loading at the same time both stay).
+#define RESOURCE_MAX_PATH 1024
+
+typedef enum {
+    RESOURCE_MESH,
+    RESOURCE_TEXTURE
+} resource_type_t;
+
+typedef struct {
+    resource_type_t type;
+    char path[RESOURCE_MAX_PATH]; // canonical path of the file it was loaded from
+    uint64_t file_size;
+    int64_t file_time;            // last modification time of the file when it was loaded
+    uint64_t content_hash;        // see file_hash in file.h, only computed once another file of the same size shows up
+    bool has_content_hash;
+    int ref_count;
+    size_t size;                  // bytes of memory it takes
+    arena_t arena;
+    mesh_t mesh;                  // the handles given out are pointers to one of these
+    texture_t texture;
+} resource_t;
+
+typedef struct {
+    resource_t** resources; // the ones with references left (array.h array)
+    SDL_mutex* mutex;
+} resource_cache_t;
+
+extern resource_cache_t resource_cache;
+
+void resource_cache_init(resource_cache_t* cache);
+
+// A reference to the mesh or texture of the file, NULL if it can't be loaded.
+// Give every reference back with the matching release function when done with it.
+mesh_t* resource_acquire_mesh(resource_cache_t* cache, const char* filename);
+texture_t* resource_acquire_texture(resource_cache_t* cache, const char* filename);
+void resource_release_mesh(resource_cache_t* cache, mesh_t* mesh);
+void resource_release_texture(resource_cache_t* cache, texture_t* texture);
+
+// Memory taken by the mesh or texture, whoever else shares it
+size_t resource_mesh_size(const mesh_t* mesh);
+size_t resource_texture_size(const texture_t* texture);
+
+// Free whatever is still referenced
+void resource_cache_free(resource_cache_t* cache);
+
+#endif
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "array.h"
+#include "scene.h"
+#include "resource_cache.h"
+
+scene_t scene = { NULL, NULL, NULL, NULL };
+
+mesh_t* scene_load_mesh(scene_t* scene, const char* filename)
+{
+    mesh_t* mesh = resource_acquire_mesh(&resource_cache, filename);
+    if (mesh == NULL)
+        return NULL;
+
+    scene_add_mesh(scene, mesh);
+    return mesh;
+}
+
+texture_t* scene_load_texture(scene_t* scene, const char* filename)
+{
+    texture_t* texture = resource_acquire_texture(&resource_cache, filename);
+    if (texture == NULL)
+    {
+        fprintf(stderr, "Error loading texture %s.\n", filename);
+        return NULL;
+    }
+
+    scene_add_texture(scene, texture);
+    return texture;
+}
+
+void scene_add_mesh(scene_t* scene, mesh_t* mesh)
+{
+    array_push(scene->meshes, mesh);
+}
+
+void scene_add_texture(scene_t* scene, texture_t* texture)
+{
+    array_push(scene->textures, texture);
+}
+
+mesh_instance_t* scene_add_instance(scene_t* scene, mesh_t* mesh, const texture_t* texture)
+{
+    mesh_instance_t instance = {
+        .mesh = mesh,
+        .texture = texture,
+        .transform = TRANSFORM_IDENTITY,
+        .color = mesh->color
+    };
+    array_push(scene->instances, instance);
+    return &scene->instances[array_length(scene->instances) - 1];
+}
+
+mesh_instance_t* scene_add_instances(scene_t* scene, mesh_t* mesh, const texture_t* texture,
+    const transform_t* transforms, const uint32_t* colors, int count)
+{
+    size_t first = array_length(scene->instances);
+    array_reserve(scene->instances, first + count);
+    for (int i = 0; i < count; i++)
+    {
+        mesh_instance_t instance = {
+            .mesh = mesh,
+            .texture = texture,
+            .transform = transforms[i],
+            .color = (colors != NULL) ? colors[i] : mesh->color
+        };
+        instance.transform.is_dirty = true; // the world bounds come with the world matrix
+        array_push(scene->instances, instance);
+    }
+    return &scene->instances[first];
+}
+
+int scene_num_instances(const scene_t* scene)
+{
+    return (int)array_length(scene->instances);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// World space bounds of an instance, from the object space bounds of its mesh.
+// The box center goes through the world matrix, and each half extent of the new box
+// is the sum of the mesh half extents weighted by the absolute values of the matrix (Arvo).
+// The sphere grows with the largest scale, so it stays a sphere.
+///////////////////////////////////////////////////////////////////////////////
+static void update_instance_bounds(mesh_instance_t* instance)
+{
+    const mesh_t* mesh = instance->mesh;
+    const mat4_t* m = &instance->transform.world_matrix;
+
+    vec3_t center = vec3_mul(vec3_add(mesh->bounds_min, mesh->bounds_max), 0.5f);
+    vec3_t extent = vec3_mul(vec3_sub(mesh->bounds_max, mesh->bounds_min), 0.5f);
+    float centers[3] = { center.x, center.y, center.z };
+    float extents[3] = { extent.x, extent.y, extent.z };
+    float world_center[3], world_extent[3];
+    for (int row = 0; row < 3; row++)
+    {
+        world_center[row] = m->m[row][3];
+        world_extent[row] = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            world_center[row] += m->m[row][column] * centers[column];
+            world_extent[row] += fabsf(m->m[row][column]) * extents[column];
+        }
+    }
+    vec3_t box_center = { world_center[0], world_center[1], world_center[2] };
+    vec3_t box_extent = { world_extent[0], world_extent[1], world_extent[2] };
+    instance->bounds_min = vec3_sub(box_center, box_extent);
+    instance->bounds_max = vec3_add(box_center, box_extent);
+
+    vec3_t scale = instance->transform.scale;
+    float max_scale = fmaxf(fabsf(scale.x), fmaxf(fabsf(scale.y), fabsf(scale.z)));
+    instance->bounds_center = vec3_from_vec4(mat4_mul_vec4(*m, vec4_from_vec3(mesh->bounds_center)));
+    instance->bounds_radius = mesh->bounds_radius * max_scale;
+}
+
+void scene_update_transforms(scene_t* scene, mat4_t view_matrix, mat4_t proj_matrix)
+{
+    array_resize(scene->moved_instances, 0);
+    int num_instances = scene_num_instances(scene);
+    for (int i = 0; i < num_instances; i++)
+    {
+        mesh_instance_t* instance = &scene->instances[i];
+        bool moved = instance->transform.is_dirty;
+        transform_update(&instance->transform, view_matrix, proj_matrix);
+        if (moved)
+        {
+            update_instance_bounds(instance);
+            array_push(scene->moved_instances, i);
+        }
+    }
+}
+
+void scene_invalidate_mesh_bounds(scene_t* scene, const mesh_t* mesh)
+{
+    int num_instances = scene_num_instances(scene);
+    for (int i = 0; i < num_instances; i++)
+    {
+        if (scene->instances[i].mesh == mesh)
+            scene->instances[i].transform.is_dirty = true;
+    }
+}
+
+void scene_free(scene_t* scene)
+{
+    for (size_t i = 0; i < array_length(scene->meshes); i++)
+        resource_release_mesh(&resource_cache, scene->meshes[i]);
+    for (size_t i = 0; i < array_length(scene->textures); i++)
+        resource_release_texture(&resource_cache, scene->textures[i]);
+
+    array_free(scene->meshes);
+    array_free(scene->textures);
+    array_free(scene->instances);
+    array_free(scene->moved_instances);
+    scene->meshes = NULL;
+    scene->textures = NULL;
+    scene->instances = NULL;
+    scene->moved_instances = NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "vector.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "texture.h"
+#include "transform.h"
+
+// One object of the scene: a mesh placed somewhere in the world, with its texture.
+// Any number of instances can share the same mesh and texture.
+typedef struct {
+    mesh_t* mesh;
+    const texture_t* texture; // NULL draws the mesh color, even in the textured render modes
+    transform_t transform;    // scale, rotation and translation, and the matrices cached from them
+    uint32_t color;           // base color of the faces before shading, the mesh color unless set otherwise
+
+    // Bounds of the mesh in world space, brought up to date by scene_update_transforms
+    // when the instance moves. The box is the mesh box transformed, and boxed again.
+    vec3_t bounds_min;
+    vec3_t bounds_max;
+    vec3_t bounds_center;
+    float bounds_radius;
+} mesh_instance_t;
+
+// Everything there is to draw.
+// The meshes and textures come from the resource cache (see resource_cache.h), shared with whatever else
+// loaded the same files, and pointers to them stay valid until scene_free gives them back.
+// The instances are an array.h array: don't keep pointers to them across scene_add_instance.
+typedef struct {
+    mesh_t** meshes;
+    texture_t** textures;
+    mesh_instance_t* instances;
+    int* moved_instances; // indices of the instances whose bounds changed in the last scene_update_transforms
+} scene_t;
+
+extern scene_t scene;
+
+// NULL when the file can't be loaded. Loading a file twice gives the same mesh or texture.
+mesh_t* scene_load_mesh(scene_t* scene, const char* filename);
+texture_t* scene_load_texture(scene_t* scene, const char* filename);
+
+// Give the scene a reference acquired from the resource cache, it releases it in scene_free
+void scene_add_mesh(scene_t* scene, mesh_t* mesh);
+void scene_add_texture(scene_t* scene, texture_t* texture);
+
+// Add an instance with an identity transform, and return it
+mesh_instance_t* scene_add_instance(scene_t* scene, mesh_t* mesh, const texture_t* texture);
+
+// Add count instances of the same mesh at once (a crowd, a fleet), one per transform, and return the first
+// of them (the others follow it). colors has one color per instance, or is NULL for the mesh color.
+// Build the transforms from TRANSFORM_IDENTITY with the transform functions, the matrices are computed later.
+// The instances of a mesh are processed together, so its object space data is shared by all of them every frame.
+mesh_instance_t* scene_add_instances(scene_t* scene, mesh_t* mesh, const texture_t* texture,
+    const transform_t* transforms, const uint32_t* colors, int count);
+int scene_num_instances(const scene_t* scene);
+
+// Bring the cached matrices of every instance up to date with the camera,
+// and the world bounds of the instances that moved (listed in scene->moved_instances)
+void scene_update_transforms(scene_t* scene, mat4_t view_matrix, mat4_t proj_matrix);
+
+// The bounds of the mesh changed (it was streamed in or out, see streaming.h):
+// the instances using it get new world bounds in the next scene_update_transforms
+void scene_invalidate_mesh_bounds(scene_t* scene, const mesh_t* mesh);
+
+// Give the meshes and textures back to the resource cache and free the arrays of the scene
+void scene_free(scene_t* scene);
+
+#endif
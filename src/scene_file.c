@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>    // for SDL threads
+#include "array.h"
+#include "camera.h"
+#include "light.h"
+#include "resource_cache.h"
+#include "streaming.h"
+#include "scene_file.h"
+
+#define SCENE_FILE_SEPARATORS " \t\r\n"
+
+// A mesh or texture statement
+typedef struct {
+    char name[SCENE_FILE_MAX_NAME];
+    char path[SCENE_FILE_MAX_LINE];
+    bool is_texture;
+    bool is_streamed;
+    mesh_t* mesh;       // once loaded (NULL if it couldn't be)
+    texture_t* texture;
+} scene_file_asset_t;
+
+// An instance statement
+typedef struct {
+    int mesh;           // index of the mesh in the assets
+    int texture;        // index of the texture in the assets, -1 for none
+    transform_t transform;
+    uint32_t color;
+    bool has_color;
+} scene_file_instance_t;
+
+// Everything read from the file, applied to the scene only once all of it was understood
+typedef struct {
+    scene_file_asset_t* assets;       // array.h arrays
+    scene_file_instance_t* instances;
+    camera_t camera;
+    light_t light;
+    SDL_atomic_t next_asset;          // the next asset a loading thread takes
+} scene_description_t;
+
+static int find_asset(const scene_description_t* description, bool is_texture, const char* name)
+{
+    for (size_t i = 0; i < array_length(description->assets); i++)
+    {
+        if (description->assets[i].is_texture == is_texture && strcmp(description->assets[i].name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+// The next count numbers of the statement being parsed (see strtok)
+static bool parse_floats(float* values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        char* token = strtok(NULL, SCENE_FILE_SEPARATORS);
+        if (token == NULL)
+            return false;
+        char* end;
+        values[i] = strtof(token, &end);
+        if (*end != '\0')
+            return false;
+    }
+    return true;
+}
+
+static bool parse_vec3(vec3_t* vector)
+{
+    float values[3];
+    if (!parse_floats(values, 3))
+        return false;
+    vector->x = values[0];
+    vector->y = values[1];
+    vector->z = values[2];
+    return true;
+}
+
+static const char* parse_asset(scene_description_t* description, bool is_texture)
+{
+    char* name = strtok(NULL, SCENE_FILE_SEPARATORS);
+    char* path = strtok(NULL, SCENE_FILE_SEPARATORS);
+    char* option = strtok(NULL, SCENE_FILE_SEPARATORS);
+    if (name == NULL || path == NULL)
+        return "expected a name and a file";
+    if (strlen(name) >= SCENE_FILE_MAX_NAME)
+        return "name too long";
+    if (find_asset(description, is_texture, name) >= 0)
+        return "name already used";
+    if (option != NULL && strcmp(option, "streamed") != 0)
+        return "unknown option";
+
+    scene_file_asset_t asset = { .is_texture = is_texture, .is_streamed = (option != NULL) };
+    strcpy(asset.name, name);
+    strcpy(asset.path, path); // a part of the line, so it fits
+    array_push(description->assets, asset);
+    return NULL;
+}
+
+static const char* parse_instance(scene_description_t* description)
+{
+    char* mesh_name = strtok(NULL, SCENE_FILE_SEPARATORS);
+    char* texture_name = strtok(NULL, SCENE_FILE_SEPARATORS);
+    if (mesh_name == NULL || texture_name == NULL)
+        return "expected a mesh and a texture (or -)";
+
+    scene_file_instance_t instance = { .transform = TRANSFORM_IDENTITY };
+    instance.mesh = find_asset(description, false, mesh_name);
+    instance.texture = (strcmp(texture_name, "-") == 0) ? -1 : find_asset(description, true, texture_name);
+    if (instance.mesh < 0)
+        return "unknown mesh";
+    if (instance.texture < 0 && strcmp(texture_name, "-") != 0)
+        return "unknown texture";
+
+    char* option;
+    while ((option = strtok(NULL, SCENE_FILE_SEPARATORS)) != NULL)
+    {
+        vec3_t vector;
+        if (strcmp(option, "translation") == 0 && parse_vec3(&vector))
+            transform_set_translation(&instance.transform, vector);
+        else if (strcmp(option, "rotation") == 0 && parse_vec3(&vector))
+            transform_set_rotation(&instance.transform, vector);
+        else if (strcmp(option, "scale") == 0 && parse_vec3(&vector))
+            transform_set_scale(&instance.transform, vector);
+        else if (strcmp(option, "color") == 0)
+        {
+            char* token = strtok(NULL, SCENE_FILE_SEPARATORS);
+            char* end;
+            if (token == NULL)
+                return "expected a color";
+            instance.color = (uint32_t)strtoul(token, &end, 16);
+            instance.has_color = true;
+            if (*end != '\0')
+                return "expected a color";
+        }
+        else
+            return "unknown option, or not enough numbers after it";
+    }
+
+    array_push(description->instances, instance);
+    return NULL;
+}
+
+static const char* parse_camera(scene_description_t* description)
+{
+    char* option;
+    while ((option = strtok(NULL, SCENE_FILE_SEPARATORS)) != NULL)
+    {
+        if (strcmp(option, "position") == 0 && parse_vec3(&description->camera.position))
+            continue;
+        if (strcmp(option, "yaw") == 0 && parse_floats(&description->camera.yaw, 1))
+            continue;
+        return "unknown option, or not enough numbers after it";
+    }
+    return NULL;
+}
+
+static const char* parse_light(scene_description_t* description)
+{
+    char* option;
+    while ((option = strtok(NULL, SCENE_FILE_SEPARATORS)) != NULL)
+    {
+        if (strcmp(option, "direction") == 0 && parse_vec3(&description->light.direction))
+            continue;
+        return "unknown option, or not enough numbers after it";
+    }
+    vec3_normalize(&description->light.direction);
+    return NULL;
+}
+
+// NULL if the statement is fine, what's wrong with it otherwise
+static const char* parse_statement(scene_description_t* description, char* line)
+{
+    char* comment = strchr(line, '#');
+    if (comment != NULL)
+        *comment = '\0';
+
+    char* keyword = strtok(line, SCENE_FILE_SEPARATORS);
+    if (keyword == NULL)
+        return NULL; // nothing but spaces and comments
+    if (strcmp(keyword, "mesh") == 0)
+        return parse_asset(description, false);
+    if (strcmp(keyword, "texture") == 0)
+        return parse_asset(description, true);
+    if (strcmp(keyword, "instance") == 0)
+        return parse_instance(description);
+    if (strcmp(keyword, "camera") == 0)
+        return parse_camera(description);
+    if (strcmp(keyword, "light") == 0)
+        return parse_light(description);
+    return "unknown statement";
+}
+
+static bool parse_scene_file(scene_description_t* description, const char* filename)
+{
+    FILE* file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening scene file %s.\n", filename);
+        return false;
+    }
+
+    char line[SCENE_FILE_MAX_LINE];
+    int line_number = 0;
+    const char* error = NULL;
+    while (error == NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        line_number++;
+        if (strchr(line, '\n') == NULL && !feof(file))
+            error = "line too long";
+        else
+            error = parse_statement(description, line);
+    }
+    fclose(file);
+
+    if (error != NULL)
+        fprintf(stderr, "Error in scene file %s, line %d: %s.\n", filename, line_number, error);
+    return error == NULL;
+}
+
+// Every loading thread takes the next asset nobody took yet, until there are none left
+static int SDLCALL load_assets(void* data)
+{
+    scene_description_t* description = (scene_description_t*)data;
+    int num_assets = (int)array_length(description->assets);
+    for (int i = SDL_AtomicAdd(&description->next_asset, 1); i < num_assets; i = SDL_AtomicAdd(&description->next_asset, 1))
+    {
+        scene_file_asset_t* asset = &description->assets[i];
+        if (asset->is_streamed)
+            continue;
+        if (asset->is_texture)
+            asset->texture = resource_acquire_texture(&resource_cache, asset->path);
+        else
+            asset->mesh = resource_acquire_mesh(&resource_cache, asset->path);
+    }
+    return 0;
+}
+
+// Load all the assets that aren't streamed at once, the calling thread too.
+// When threads can't be created the others just do more of the work.
+static void load_all_assets(scene_description_t* description)
+{
+    int num_assets = (int)array_length(description->assets);
+    int num_threads = SDL_GetCPUCount();
+    if (num_threads > SCENE_FILE_MAX_THREADS)
+        num_threads = SCENE_FILE_MAX_THREADS;
+    if (num_threads > num_assets)
+        num_threads = num_assets;
+
+    SDL_Thread* threads[SCENE_FILE_MAX_THREADS] = { NULL };
+    SDL_AtomicSet(&description->next_asset, 0);
+    for (int i = 1; i < num_threads; i++)
+        threads[i] = SDL_CreateThread(load_assets, "scene_asset", description);
+    load_assets(description);
+    for (int i = 1; i < num_threads; i++)
+    {
+        if (threads[i] != NULL)
+            SDL_WaitThread(threads[i], NULL);
+    }
+}
+
+bool load_scene_file(scene_t* scene, const char* filename, arena_t* arena)
+{
+    scene_description_t description = { NULL, NULL, camera, light };
+    bool is_parsed = parse_scene_file(&description, filename);
+    if (is_parsed)
+    {
+        load_all_assets(&description);
+
+        // The scene holds the references from now on
+        for (size_t i = 0; i < array_length(description.assets); i++)
+        {
+            scene_file_asset_t* asset = &description.assets[i];
+            if (asset->is_streamed && asset->is_texture)
+                asset->texture = streaming_add_texture(&streamer, asset->path, arena);
+            else if (asset->is_streamed)
+                asset->mesh = streaming_add_mesh(&streamer, asset->path, arena);
+            else if (asset->is_texture && asset->texture != NULL)
+                scene_add_texture(scene, asset->texture);
+            else if (!asset->is_texture && asset->mesh != NULL)
+                scene_add_mesh(scene, asset->mesh);
+
+            if (asset->mesh == NULL && asset->texture == NULL)
+                fprintf(stderr, "Error loading %s.\n", asset->path);
+        }
+
+        for (size_t i = 0; i < array_length(description.instances); i++)
+        {
+            const scene_file_instance_t* parsed = &description.instances[i];
+            mesh_t* mesh = description.assets[parsed->mesh].mesh;
+            const texture_t* texture = (parsed->texture >= 0) ? description.assets[parsed->texture].texture : NULL;
+            if (mesh == NULL)
+                continue;
+
+            mesh_instance_t* instance = scene_add_instance(scene, mesh, texture);
+            instance->transform = parsed->transform;
+            if (parsed->has_color)
+                instance->color = parsed->color;
+        }
+
+        camera = description.camera;
+        light = description.light;
+    }
+
+    array_free(description.assets);
+    array_free(description.instances);
+    return is_parsed;
+}
@@ -0,0 +1,33 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <stdbool.h>
+#include "arena.h"
+#include "scene.h"
+
+// Scene description files (like assets/f22.scene): what to load, where to put it, and where the camera
+// and the light start, so scenes can change without recompiling.
+//
+// Plain text, one statement per line, anything after a # is a comment:
+//
+//   mesh <name> <file.obj> [streamed]
+//   texture <name> <file.png> [streamed]
+//   instance <mesh name> <texture name, or - for none> [translation x y z] [rotation x y z] [scale x y z] [color 0xAABBGGRR]
+//   camera [position x y z] [yaw angle]
+//   light [direction x y z]
+//
+// Meshes and textures are declared (with names of their own) before the instances using them.
+// Angles are in radians, colors in the format of the color buffer. Paths are relative to the working directory.
+// All the meshes and textures load at once, on up to SCENE_FILE_MAX_THREADS threads, before any instance is added.
+// The streamed ones are only loaded when the camera gets near them (see streaming.h).
+#define SCENE_FILE_MAX_THREADS 8
+#define SCENE_FILE_MAX_LINE 1024
+#define SCENE_FILE_MAX_NAME 64
+
+// Add everything the file describes to the scene, and set the camera and the light.
+// Nothing is added when the file has an error (reported with its line number), a mesh or texture
+// that can't be loaded only leaves out the instances using it.
+// The streamed assets come from arena.
+bool load_scene_file(scene_t* scene, const char* filename, arena_t* arena);
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "array.h"
+#include "streaming.h"
+#include "resource_cache.h"
+
+streamer_t streamer = { .memory_budget = STREAM_DEFAULT_MEMORY_BUDGET };
+
+// The queued asset with the lowest priority, NULL if there is none (call with the mutex locked)
+static stream_asset_t* next_queued_asset(streamer_t* streamer)
+{
+    stream_asset_t* next = NULL;
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+    {
+        stream_asset_t* asset = streamer->assets[i];
+        if (asset->state == STREAM_QUEUED && (next == NULL || asset->priority < next->priority))
+            next = asset;
+    }
+    return next;
+}
+
+// Load a queued asset into loaded_mesh or loaded_texture, and mark it loaded (or failed).
+// The loading itself happens without the mutex: nothing else touches those while the asset is loading.
+static void load_asset(streamer_t* streamer, stream_asset_t* asset)
+{
+    asset->state = STREAM_LOADING;
+    SDL_UnlockMutex(streamer->mutex);
+
+    if (asset->type == STREAM_MESH)
+        asset->loaded_mesh = resource_acquire_mesh(&resource_cache, asset->filename);
+    else
+        asset->loaded_texture = resource_acquire_texture(&resource_cache, asset->filename);
+    bool is_loaded = (asset->loaded_mesh != NULL || asset->loaded_texture != NULL);
+    if (!is_loaded)
+        fprintf(stderr, "Error streaming in %s.\n", asset->filename);
+
+    SDL_LockMutex(streamer->mutex);
+    asset->state = is_loaded ? STREAM_LOADED : STREAM_FAILED;
+}
+
+static int SDLCALL streaming_thread(void* data)
+{
+    streamer_t* streamer = (streamer_t*)data;
+    SDL_LockMutex(streamer->mutex);
+    while (!streamer->quit)
+    {
+        stream_asset_t* asset = next_queued_asset(streamer);
+        if (asset != NULL)
+            load_asset(streamer, asset);
+        else
+            SDL_CondWait(streamer->wake, streamer->mutex);
+    }
+    SDL_UnlockMutex(streamer->mutex);
+    return 0;
+}
+
+// Without threads (if they can't be created) streaming_update loads one asset per frame itself
+static void start_threads(streamer_t* streamer)
+{
+    streamer->mutex = SDL_CreateMutex();
+    streamer->wake = SDL_CreateCond();
+    if (streamer->mutex == NULL || streamer->wake == NULL)
+    {
+        fprintf(stderr, "Error creating the streaming threads: %s\n", SDL_GetError());
+        return;
+    }
+
+    for (int i = 0; i < STREAM_NUM_THREADS; i++)
+    {
+        SDL_Thread* thread = SDL_CreateThread(streaming_thread, "streaming", streamer);
+        if (thread != NULL)
+            streamer->threads[streamer->num_threads++] = thread;
+    }
+    if (streamer->num_threads == 0)
+        fprintf(stderr, "Error creating the streaming threads: %s\n", SDL_GetError());
+}
+
+static stream_asset_t* add_asset(streamer_t* streamer, stream_asset_type_t type, const char* filename, arena_t* arena)
+{
+    size_t num_assets = array_length(streamer->assets);
+    for (size_t i = 0; i < num_assets; i++)
+    {
+        if (streamer->assets[i]->type == type && strcmp(streamer->assets[i]->filename, filename) == 0)
+            return streamer->assets[i];
+    }
+
+    stream_asset_t* asset = (stream_asset_t*)arena_alloc(arena, sizeof(stream_asset_t));
+    char* name = (char*)arena_alloc(arena, strlen(filename) + 1);
+    if (asset == NULL || name == NULL)
+        return NULL;
+    memset(asset, 0, sizeof(stream_asset_t));
+    strcpy(name, filename);
+    asset->type = type;
+    asset->filename = name;
+    asset->state = STREAM_UNLOADED;
+    asset->priority = FLT_MAX;
+    asset->mesh.color = 0xFFFFFFFF; // the color of every loaded mesh, the instances take it when they are added
+
+    if (streamer->mutex == NULL)
+        start_threads(streamer);
+
+    // Keep the array sorted by address, so the asset of an instance is a binary search away
+    SDL_LockMutex(streamer->mutex);
+    size_t position = num_assets;
+    while (position > 0 && (uintptr_t)streamer->assets[position - 1] > (uintptr_t)asset)
+        position--;
+    array_push(streamer->assets, asset);
+    memmove(&streamer->assets[position + 1], &streamer->assets[position], sizeof(stream_asset_t*) * (num_assets - position));
+    streamer->assets[position] = asset;
+    SDL_UnlockMutex(streamer->mutex);
+    return asset;
+}
+
+mesh_t* streaming_add_mesh(streamer_t* streamer, const char* filename, arena_t* arena)
+{
+    stream_asset_t* asset = add_asset(streamer, STREAM_MESH, filename, arena);
+    return (asset != NULL) ? &asset->mesh : NULL;
+}
+
+texture_t* streaming_add_texture(streamer_t* streamer, const char* filename, arena_t* arena)
+{
+    stream_asset_t* asset = add_asset(streamer, STREAM_TEXTURE, filename, arena);
+    return (asset != NULL) ? &asset->texture : NULL;
+}
+
+// The streamed asset the mesh or texture at address belongs to, NULL if it isn't a streamed one
+static stream_asset_t* find_asset(const streamer_t* streamer, const void* address)
+{
+    uintptr_t target = (uintptr_t)address;
+    size_t low = 0;
+    size_t high = array_length(streamer->assets);
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if ((uintptr_t)streamer->assets[middle] <= target)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return NULL;
+
+    stream_asset_t* asset = streamer->assets[low - 1];
+    return (target < (uintptr_t)(asset + 1)) ? asset : NULL;
+}
+
+// How far the instance is from the camera for streaming: from the camera to its bounding sphere,
+// STREAM_OUT_OF_VIEW_FACTOR times that when it isn't in front of the camera (camera_direction is unit length)
+static float instance_priority(const mesh_instance_t* instance, vec3_t camera_position, vec3_t camera_direction)
+{
+    vec3_t to_instance = vec3_sub(instance->bounds_center, camera_position);
+    float distance = vec3_length(to_instance);
+    if (distance <= instance->bounds_radius)
+        return 0.0f;
+
+    float priority = distance - instance->bounds_radius;
+    if (vec3_dot(to_instance, camera_direction) < STREAM_VIEW_COS * distance)
+        priority *= STREAM_OUT_OF_VIEW_FACTOR;
+    return priority;
+}
+
+static void update_priorities(streamer_t* streamer, const scene_t* scene, vec3_t camera_position, vec3_t camera_direction)
+{
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+        streamer->assets[i]->priority = FLT_MAX;
+
+    // Instances of the same mesh usually come one after the other, they share the lookups
+    const mesh_t* last_mesh = NULL;
+    const texture_t* last_texture = NULL;
+    stream_asset_t* mesh_asset = NULL;
+    stream_asset_t* texture_asset = NULL;
+    int num_instances = scene_num_instances(scene);
+    for (int i = 0; i < num_instances; i++)
+    {
+        const mesh_instance_t* instance = &scene->instances[i];
+        if (instance->mesh != last_mesh)
+        {
+            last_mesh = instance->mesh;
+            mesh_asset = find_asset(streamer, last_mesh);
+        }
+        if (instance->texture != last_texture)
+        {
+            last_texture = instance->texture;
+            texture_asset = (last_texture != NULL) ? find_asset(streamer, last_texture) : NULL;
+        }
+        if (mesh_asset == NULL && texture_asset == NULL)
+            continue;
+
+        float priority = instance_priority(instance, camera_position, camera_direction);
+        if (mesh_asset != NULL && priority < mesh_asset->priority)
+            mesh_asset->priority = priority;
+        if (texture_asset != NULL && priority < texture_asset->priority)
+            texture_asset->priority = priority;
+    }
+}
+
+// The instances see the loaded data from now on, and the mesh bounds along with it
+static void make_resident(streamer_t* streamer, scene_t* scene, stream_asset_t* asset)
+{
+    if (asset->type == STREAM_MESH)
+    {
+        asset->mesh = *asset->loaded_mesh;
+        asset->size = resource_mesh_size(asset->loaded_mesh);
+        scene_invalidate_mesh_bounds(scene, &asset->mesh);
+    }
+    else
+    {
+        asset->texture = *asset->loaded_texture;
+        asset->size = resource_texture_size(asset->loaded_texture);
+    }
+    streamer->memory_used += asset->size;
+    asset->state = STREAM_RESIDENT;
+}
+
+// Back to an empty mesh (with empty bounds) or a texture without pixels, until it's loaded again
+static void evict(streamer_t* streamer, scene_t* scene, stream_asset_t* asset)
+{
+    if (asset->type == STREAM_MESH)
+    {
+        asset->mesh = (mesh_t){ .color = asset->mesh.color };
+        scene_invalidate_mesh_bounds(scene, &asset->mesh);
+        resource_release_mesh(&resource_cache, asset->loaded_mesh);
+        asset->loaded_mesh = NULL;
+    }
+    else
+    {
+        asset->texture = (texture_t){ NULL, 0, 0 };
+        resource_release_texture(&resource_cache, asset->loaded_texture);
+        asset->loaded_texture = NULL;
+    }
+    streamer->memory_used -= asset->size;
+    asset->state = STREAM_UNLOADED;
+}
+
+// The resident asset with the highest priority, NULL if there is none
+static stream_asset_t* coldest_resident_asset(streamer_t* streamer)
+{
+    stream_asset_t* coldest = NULL;
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+    {
+        stream_asset_t* asset = streamer->assets[i];
+        if (asset->state == STREAM_RESIDENT && (coldest == NULL || asset->priority > coldest->priority))
+            coldest = asset;
+    }
+    return coldest;
+}
+
+void streaming_update(streamer_t* streamer, scene_t* scene, vec3_t camera_position, vec3_t camera_direction)
+{
+    if (array_length(streamer->assets) == 0)
+        return;
+
+    SDL_LockMutex(streamer->mutex);
+    update_priorities(streamer, scene, camera_position, camera_direction);
+
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+    {
+        if (streamer->assets[i]->state == STREAM_LOADED)
+            make_resident(streamer, scene, streamer->assets[i]);
+    }
+
+    // Over budget, the furthest assets go first, even the ones in use if it comes to that
+    while (streamer->memory_used > streamer->memory_budget)
+    {
+        stream_asset_t* coldest = coldest_resident_asset(streamer);
+        if (coldest == NULL)
+            break;
+        evict(streamer, scene, coldest);
+    }
+
+    // Load the assets that are near enough when they fit in the budget (as far as we know their size),
+    // or when there are resident ones further away to make room for them.
+    // An asset evicted to make room doesn't come back until something changes, so nothing is loaded over and over.
+    stream_asset_t* coldest = coldest_resident_asset(streamer);
+    bool has_queued = false;
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+    {
+        stream_asset_t* asset = streamer->assets[i];
+        bool is_wanted = (asset->priority < STREAM_LOAD_DISTANCE);
+        bool fits = (streamer->memory_used + asset->size <= streamer->memory_budget) ||
+            (coldest != NULL && asset->priority < coldest->priority);
+        if (asset->state == STREAM_QUEUED && !is_wanted)
+            asset->state = STREAM_UNLOADED;
+        else if (asset->state == STREAM_UNLOADED && is_wanted && fits)
+            asset->state = STREAM_QUEUED;
+        has_queued |= (asset->state == STREAM_QUEUED);
+    }
+
+    if (has_queued && streamer->num_threads > 0)
+        SDL_CondBroadcast(streamer->wake);
+    else if (has_queued)
+        load_asset(streamer, next_queued_asset(streamer)); // resident next frame
+    SDL_UnlockMutex(streamer->mutex);
+}
+
+void streaming_free(streamer_t* streamer)
+{
+    // The threads finish the asset they are loading first
+    if (streamer->mutex != NULL)
+    {
+        SDL_LockMutex(streamer->mutex);
+        streamer->quit = true;
+        SDL_CondBroadcast(streamer->wake);
+        SDL_UnlockMutex(streamer->mutex);
+    }
+    for (int i = 0; i < streamer->num_threads; i++)
+        SDL_WaitThread(streamer->threads[i], NULL);
+
+    for (size_t i = 0; i < array_length(streamer->assets); i++)
+    {
+        stream_asset_t* asset = streamer->assets[i];
+        if (asset->loaded_mesh != NULL)
+            resource_release_mesh(&resource_cache, asset->loaded_mesh);
+        if (asset->loaded_texture != NULL)
+            resource_release_texture(&resource_cache, asset->loaded_texture);
+    }
+
+    SDL_DestroyCond(streamer->wake);
+    SDL_DestroyMutex(streamer->mutex);
+    array_free(streamer->assets);
+    streamer->assets = NULL;
+    streamer->mutex = NULL;
+    streamer->wake = NULL;
+    streamer->num_threads = 0;
+    streamer->memory_used = 0;
+}
@@ -0,0 +1,85 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <SDL.h>    // for SDL threads
+#include "vector.h"
+#include "mesh.h"
+#include "texture.h"
+#include "arena.h"
+#include "scene.h"
+
+// Streaming: meshes and textures that are only in memory while the camera is near the instances using them,
+// for worlds with more assets than fit in memory at once.
+//
+// A streamed mesh or texture is added without being loaded, and the instances point to it like to any other.
+// Until it is resident the mesh is empty (no levels of detail, so the instances aren't drawn)
+// and the texture has no pixels (so the instances are drawn with their color).
+//
+// Every frame streaming_update gives each asset a priority: the distance from the camera to the nearest
+// instance using it, counted STREAM_OUT_OF_VIEW_FACTOR times further when the instance isn't in front of the camera.
+// The assets nearer than STREAM_LOAD_DISTANCE get loaded by STREAM_NUM_THREADS background threads, nearest first,
+// and when the resident ones take more than the memory budget the furthest of them are evicted.
+// Loaded data only reaches the instances in streaming_update, so the frame never sees anything half loaded.
+// The files are loaded through the resource cache (see resource_cache.h), so an asset also used outside of
+// streaming (or by another streamed asset) is shared, and only really leaves memory when nobody else uses it either.
+#define STREAM_NUM_THREADS 2
+#define STREAM_LOAD_DISTANCE 50.0f        // world units
+#define STREAM_OUT_OF_VIEW_FACTOR 2.0f
+#define STREAM_VIEW_COS 0.5f              // instances within 60 degrees of the camera direction are in view
+#define STREAM_DEFAULT_MEMORY_BUDGET ((size_t)256 * 1024 * 1024)
+
+typedef enum {
+    STREAM_UNLOADED,
+    STREAM_QUEUED,   // waiting for a thread
+    STREAM_LOADING,  // a thread is on it
+    STREAM_LOADED,   // waiting for streaming_update to hand it to the instances
+    STREAM_RESIDENT,
+    STREAM_FAILED    // the file couldn't be loaded, it isn't tried again
+} stream_state_t;
+
+typedef enum {
+    STREAM_MESH,
+    STREAM_TEXTURE
+} stream_asset_type_t;
+
+typedef struct {
+    stream_asset_type_t type;
+    char* filename;
+    stream_state_t state;
+    float priority;          // lower loads first, higher is evicted first (FLT_MAX when no instance uses it)
+    size_t size;             // bytes it takes when resident (0 until loaded the first time)
+    mesh_t mesh;             // what the instances point to, a copy of loaded_mesh while resident
+    texture_t texture;
+    mesh_t* loaded_mesh;     // reference from the resource cache while loaded, set by the loading thread
+    texture_t* loaded_texture;
+} stream_asset_t;
+
+typedef struct {
+    stream_asset_t** assets; // sorted by address (array.h array), the assets themselves never move
+    size_t memory_budget;    // bytes the resident assets may take, change it at any time
+    size_t memory_used;
+    SDL_Thread* threads[STREAM_NUM_THREADS];
+    int num_threads;         // started with the first asset
+    SDL_mutex* mutex;        // guards the assets array and the state and priority of every asset
+    SDL_cond* wake;          // signaled when there is something to load, or when it's time to quit
+    bool quit;
+} streamer_t;
+
+extern streamer_t streamer;
+
+// The mesh or texture of the file, not loaded yet, to give to scene_add_instance (or scene_add_instances).
+// Adding the same file twice returns the same one. The asset itself comes from arena.
+mesh_t* streaming_add_mesh(streamer_t* streamer, const char* filename, arena_t* arena);
+texture_t* streaming_add_texture(streamer_t* streamer, const char* filename, arena_t* arena);
+
+// Call once per frame, before scene_update_transforms: hands the assets loaded since the last call
+// to their instances (and makes the instances update their bounds), evicts the furthest assets
+// when over budget and queues the nearest ones that aren't loaded yet.
+void streaming_update(streamer_t* streamer, scene_t* scene, vec3_t camera_position, vec3_t camera_direction);
+
+// Stop the threads and give every loaded asset back to the resource cache
+void streaming_free(streamer_t* streamer);
+
+#endif
@@ -1,20 +1,28 @@
 #include <stdio.h>
+#include <string.h>
 #include "texture.h"
+#include "upng.h"
 
-int texture_width = 64;
-int texture_height = 64;
-
-upng_t* png_texture = NULL;
-uint32_t* mesh_texture = NULL;
-
-void load_png_texture_data(char* filename) {
-    png_texture = upng_new_from_file(filename);
+bool load_png_texture_data(texture_t* texture, const char* filename, arena_t* arena) {
+    bool loaded = false;
+    upng_t* png_texture = upng_new_from_file(filename);
     if (png_texture != NULL) {
         upng_decode(png_texture);
         if (upng_get_error(png_texture) == UPNG_EOK) {
-            mesh_texture = (uint32_t*)upng_get_buffer(png_texture);
-            texture_width = upng_get_width(png_texture);
-            texture_height = upng_get_height(png_texture);
+            // upng decodes through buffers of its own, only the final pixels are kept (in the arena)
+            int width = upng_get_width(png_texture);
+            int height = upng_get_height(png_texture);
+            size_t size = sizeof(uint32_t) * width * height;
+            uint32_t* pixels = (uint32_t*)arena_alloc(arena, size);
+            if (pixels != NULL) {
+                memcpy(pixels, upng_get_buffer(png_texture), size);
+                texture->pixels = pixels;
+                texture->width = width;
+                texture->height = height;
+                loaded = true;
+            }
         }
+        upng_free(png_texture);
     }
+    return loaded;
 }
\ No newline at end of file
@@ -2,21 +2,26 @@
 #define TEXTURE_H
 
 #include <stdint.h>
-#include "upng.h"
+#include <stdbool.h>
+#include "arena.h"
 
 typedef struct {
 	float u;
 	float v;
 } tex2_t;
 
-extern int texture_width;
-extern int texture_height;
+// A decoded image, every mesh instance of the scene can point to one (see scene.h)
+typedef struct {
+	uint32_t* pixels;
+	int width;
+	int height;
+	bool has_cutout; // texels with a 0 alpha are holes, nothing is drawn there (impostors, see impostor.h)
+} texture_t;
 
 extern const uint8_t REDBRICK_TEXTURE[];
 
-extern upng_t* png_texture;
-extern uint32_t* mesh_texture;
-
-void load_png_texture_data(char* filename);
+// The decoded pixels are allocated from arena (and go away with it).
+// Returns false, leaving the texture alone, when the file can't be decoded.
+bool load_png_texture_data(texture_t* texture, const char* filename, arena_t* arena);
 
 #endif
@@ -0,0 +1,76 @@
+#include <string.h> // for memcmp
+#include "transform.h"
+
+static bool same_vec3(vec3_t a, vec3_t b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static bool same_mat4(const mat4_t* a, const mat4_t* b)
+{
+    return memcmp(a->m, b->m, sizeof(a->m)) == 0;
+}
+
+// Setting the same value again (e.g. an animation that doesn't move this frame) keeps the cache
+void transform_set_scale(transform_t* transform, vec3_t scale)
+{
+    if (!same_vec3(transform->scale, scale))
+    {
+        transform->scale = scale;
+        transform->is_dirty = true;
+    }
+}
+
+void transform_set_rotation(transform_t* transform, vec3_t rotation)
+{
+    if (!same_vec3(transform->rotation, rotation))
+    {
+        transform->rotation = rotation;
+        transform->is_dirty = true;
+    }
+}
+
+void transform_set_translation(transform_t* transform, vec3_t translation)
+{
+    if (!same_vec3(transform->translation, translation))
+    {
+        transform->translation = translation;
+        transform->is_dirty = true;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Bring the cached matrices up to date with the current view and projection.
+// Call once per frame before transforming any vertex, it's only a couple of
+// matrix compares when nothing moved.
+///////////////////////////////////////////////////////////////////////////////
+void transform_update(transform_t* transform, mat4_t view_matrix, mat4_t proj_matrix)
+{
+    bool world_changed = transform->is_dirty;
+    if (world_changed)
+    {
+        // Order matters: First scale, then rotate, then translate
+        // [T]*[R]*[S]*v (expression must be read from right to left)
+        mat4_t world_matrix = mat4_make_scale(transform->scale.x, transform->scale.y, transform->scale.z);
+        world_matrix = mat4_mul_mat4(mat4_make_rotation_z(transform->rotation.z), world_matrix);
+        world_matrix = mat4_mul_mat4(mat4_make_rotation_y(transform->rotation.y), world_matrix);
+        world_matrix = mat4_mul_mat4(mat4_make_rotation_x(transform->rotation.x), world_matrix);
+        world_matrix = mat4_mul_mat4(mat4_make_translation(transform->translation.x, transform->translation.y, transform->translation.z), world_matrix);
+        transform->world_matrix = world_matrix;
+        transform->is_dirty = false;
+    }
+
+    bool view_changed = world_changed || !same_mat4(&transform->view_matrix, &view_matrix);
+    if (view_changed)
+    {
+        transform->world_view_matrix = mat4_mul_mat4(view_matrix, transform->world_matrix);
+        transform->has_world_view_inverse = mat4_inverse(transform->world_view_matrix, &transform->world_view_inverse_matrix);
+        transform->view_matrix = view_matrix;
+    }
+
+    if (view_changed || !same_mat4(&transform->proj_matrix, &proj_matrix))
+    {
+        transform->world_view_proj_matrix = mat4_mul_mat4(proj_matrix, transform->world_view_matrix);
+        transform->proj_matrix = proj_matrix;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+// Scale, rotation and translation of an object, together with the matrices built from them.
+// The matrices are cached and only rebuilt when something they depend on changes:
+// the world matrix when the scale/rotation/translation are set through the functions below,
+// the world-view and world-view-projection matrices when the camera or the projection moves too.
+// So don't write the scale/rotation/translation fields directly, or the cache won't notice.
+typedef struct {
+    vec3_t scale;       // scale with x,y and z values
+    vec3_t rotation;    // rotation with x,y and z values (angles in radians)
+    vec3_t translation; // translation with x,y and z values
+
+    mat4_t world_matrix;           // object space -> world space
+    mat4_t world_view_matrix;      // object space -> camera space
+    mat4_t world_view_proj_matrix; // object space -> clip space
+    mat4_t world_view_inverse_matrix; // camera space -> object space
+    bool has_world_view_inverse;      // false when the world-view matrix isn't invertible (e.g. a 0 scale)
+
+    mat4_t view_matrix; // the view and projection matrices the cached ones were built with
+    mat4_t proj_matrix;
+    bool is_dirty;      // scale, rotation or translation changed since the world matrix was built
+} transform_t;
+
+// Use this to initialize transforms (unit scale, no rotation or translation)
+#define TRANSFORM_IDENTITY { .scale = { 1.0, 1.0, 1.0 }, .is_dirty = true }
+
+void transform_set_scale(transform_t* transform, vec3_t scale);
+void transform_set_rotation(transform_t* transform, vec3_t rotation);
+void transform_set_translation(transform_t* transform, vec3_t translation);
+void transform_update(transform_t* transform, mat4_t view_matrix, mat4_t proj_matrix);
+
+#endif
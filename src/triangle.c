@@ -1,7 +1,188 @@
+#include <stdio.h>
+#include <string.h> // for memset
 #include "display.h"
 #include "triangle.h"
 #include "swap.h"
 
+static int min_int(int a, int b) { return (a < b) ? a : b; }
+static int max_int(int a, int b) { return (a > b) ? a : b; }
+
+///////////////////////////////////////////////////////////////////////////////
+// Does the bounding box of a triangle (sorted by y) touch the scissor rectangle?
+///////////////////////////////////////////////////////////////////////////////
+static bool triangle_in_scissor_rect(int x0, int x1, int x2, int y0, int y2)
+{
+    int x_min = min_int(x0, min_int(x1, x2));
+    int x_max = max_int(x0, max_int(x1, x2));
+    return x_max >= scissor_rect.x_min && x_min < scissor_rect.x_max
+        && y2 >= scissor_rect.y_min && y0 < scissor_rect.y_max;
+}
+
+triangle_stats_t triangle_stats;
+
+void reset_triangle_stats(void)
+{
+    memset(&triangle_stats, 0, sizeof(triangle_stats));
+}
+
+void print_triangle_stats(void)
+{
+    printf("Triangles: %d degenerate, %d points, %d small, %d large\n",
+        triangle_stats.num_triangles[TRIANGLE_DEGENERATE], triangle_stats.num_triangles[TRIANGLE_POINT],
+        triangle_stats.num_triangles[TRIANGLE_SMALL], triangle_stats.num_triangles[TRIANGLE_LARGE]);
+    printf("  zero area: %d\n", triangle_stats.area_histogram[0]);
+    printf("  under 1 pixel: %d\n", triangle_stats.area_histogram[1]);
+    for (int i = 2; i < NUM_TRIANGLE_AREA_BUCKETS - 1; i++) {
+        printf("  %d to %d pixels: %d\n", 1 << (i - 2), 1 << (i - 1), triangle_stats.area_histogram[i]);
+    }
+    printf("  %d pixels or more: %d\n", 1 << (NUM_TRIANGLE_AREA_BUCKETS - 3), triangle_stats.area_histogram[NUM_TRIANGLE_AREA_BUCKETS - 1]);
+}
+
+// Twice the signed area of a triangle (the 2D cross product of two of its edges), exact for integer vertices
+static int triangle_double_area(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    return (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Find the size class of a triangle (sorted by y), and count it in the stats of this frame
+///////////////////////////////////////////////////////////////////////////////
+static enum triangle_size classify_triangle(int x0, int y0, int x1, int y1, int x2, int y2)
+{
+    int double_area = abs(triangle_double_area(x0, y0, x1, y1, x2, y2));
+    int width = max_int(x0, max_int(x1, x2)) - min_int(x0, min_int(x1, x2));
+    int height = y2 - y0;
+
+    enum triangle_size size = TRIANGLE_LARGE;
+    if (double_area == 0) {
+        size = TRIANGLE_DEGENERATE;
+    } else if (width <= 1 && height <= 1) {
+        size = TRIANGLE_POINT;
+    } else if (width <= SMALL_TRIANGLE_MAX_SIZE && height <= SMALL_TRIANGLE_MAX_SIZE) {
+        size = TRIANGLE_SMALL;
+    }
+
+    // Area bucket, one per power of two (double_area 1 is half a pixel, 2 and 3 are 1 pixel and so on)
+    int bucket = 0;
+    if (double_area > 0) {
+        bucket = 1;
+        while (double_area > 1 && bucket < NUM_TRIANGLE_AREA_BUCKETS - 1) {
+            double_area >>= 1;
+            bucket++;
+        }
+    }
+
+    triangle_stats.num_triangles[size]++;
+    triangle_stats.area_histogram[bucket]++;
+    return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Draw the single pixel of a triangle that fits in a 1x1 box (sorted by y).
+// Such a triangle is 3 corners of a pixel square, and the scanline rules below
+// only ever give it the pixel at the left end of its horizontal edge.
+///////////////////////////////////////////////////////////////////////////////
+static void draw_point_triangle(
+    int x0, int y0, int x1, int y1, int x2, int y2,
+    vec4_t point_a, vec4_t point_b, vec4_t point_c,
+    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv,
+    uint32_t color, const texture_t* texture
+) {
+    int x = min_int(x0, min_int(x1, x2));
+    int y = (y0 == y1) ? y0 : y2; // the 2 vertices of the horizontal edge share their y
+
+    if (x < scissor_rect.x_min || x >= scissor_rect.x_max || y < scissor_rect.y_min || y >= scissor_rect.y_max) {
+        return;
+    }
+
+    uint32_t* color_row = &color_buffer[window_width * y];
+    float* depth_row = &z_buffer[window_width * y];
+    if (texture != NULL) {
+        draw_triangle_texel(x, y, texture, color_row, depth_row, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+    } else {
+        draw_triangle_pixel(x, y, color, color_row, depth_row, point_a, point_b, point_c);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Draw a small triangle by testing every pixel of its bounding box against its 3 edges.
+//
+// The scanline loops draw the pixels x_start <= x < x_end of every row from y0 to y2,
+// with x_start and x_end the (truncated) x of the triangle edges at that row,
+// which is the same as drawing pixel (x,y) when the point (x+1,y) is inside the triangle,
+// strictly right of its left edges and on or left of its right edges.
+// The edge functions below follow that exact rule, so both rasterizers agree on every pixel.
+///////////////////////////////////////////////////////////////////////////////
+static void draw_small_triangle(
+    int x0, int y0, int x1, int y1, int x2, int y2,
+    vec4_t point_a, vec4_t point_b, vec4_t point_c,
+    tex2_t a_uv, tex2_t b_uv, tex2_t c_uv,
+    uint32_t color, const texture_t* texture
+) {
+    // Pixel columns x_min to x_max - 1 (the sample point is x+1), rows y0 to y2, inside the scissor rectangle
+    int x_first = max_int(min_int(x0, min_int(x1, x2)), scissor_rect.x_min);
+    int x_last = min_int(max_int(x0, max_int(x1, x2)) - 1, scissor_rect.x_max - 1);
+    int y_first = max_int(y0, scissor_rect.y_min);
+    int y_last = min_int(y2, scissor_rect.y_max - 1);
+    if (x_first > x_last || y_first > y_last) {
+        return;
+    }
+
+    // Walk the edges in the order that keeps the inside of the triangle on their positive side
+    int xs[3] = { x0, x1, x2 };
+    int ys[3] = { y0, y1, y2 };
+    int order[3] = { 0, 1, 2 };
+    if (triangle_double_area(x0, y0, x1, y1, x2, y2) < 0) {
+        order[1] = 2;
+        order[2] = 1;
+    }
+
+    // Edge function of edge a->b: E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x),
+    // evaluated at the sample point of the first pixel and then stepped one pixel at a time
+    int edge_row[3];
+    int edge_step_x[3];
+    int edge_step_y[3];
+    for (int e = 0; e < 3; e++) {
+        int a = order[e];
+        int b = order[(e + 1) % 3];
+        int dx = xs[b] - xs[a];
+        int dy = ys[b] - ys[a];
+
+        // Edges going up have the inside on their right, they're left edges and exclude their own points
+        int bias = (dy < 0) ? -1 : 0;
+
+        edge_row[e] = dx * (y_first - ys[a]) - dy * (x_first + 1 - xs[a]) + bias;
+        edge_step_x[e] = -dy;
+        edge_step_y[e] = dx;
+    }
+
+    for (int y = y_first; y <= y_last; y++) {
+        int e0 = edge_row[0];
+        int e1 = edge_row[1];
+        int e2 = edge_row[2];
+
+        uint32_t* color_row = &color_buffer[window_width * y];
+        float* depth_row = &z_buffer[window_width * y];
+        for (int x = x_first; x <= x_last; x++) {
+            // Inside when none of the 3 edge functions is negative
+            if ((e0 | e1 | e2) >= 0) {
+                if (texture != NULL) {
+                    draw_triangle_texel(x, y, texture, color_row, depth_row, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+                } else {
+                    draw_triangle_pixel(x, y, color, color_row, depth_row, point_a, point_b, point_c);
+                }
+            }
+            e0 += edge_step_x[0];
+            e1 += edge_step_x[1];
+            e2 += edge_step_x[2];
+        }
+
+        edge_row[0] += edge_step_y[0];
+        edge_row[1] += edge_step_y[1];
+        edge_row[2] += edge_step_y[2];
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Draw a filled triangle with the flat-top/flat-bottom method
 // We split the original triangle in two, half flat-bottom and half flat-top
@@ -52,11 +233,33 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0,
         float_swap(&w0, &w1);
     }
 
+    // Zero area triangles don't cover any pixel
+    enum triangle_size size = classify_triangle(x0, y0, x1, y1, x2, y2);
+    if (size == TRIANGLE_DEGENERATE) {
+        return;
+    }
+
+    // Skip the whole triangle setup if it's entirely outside of the scissor rectangle
+    if (!triangle_in_scissor_rect(x0, x1, x2, y0, y2)) {
+        return;
+    }
+
     // Create three vector points after we sort the vertices
     vec4_t point_a = { x0, y0, z0, w0 };
     vec4_t point_b = { x1, y1, z1, w1 };
     vec4_t point_c = { x2, y2, z2, w2 };
 
+    // Tiny triangles don't need the slopes and the split below
+    tex2_t no_uv = { 0, 0 };
+    if (size == TRIANGLE_POINT) {
+        draw_point_triangle(x0, y0, x1, y1, x2, y2, point_a, point_b, point_c, no_uv, no_uv, no_uv, color, NULL);
+        return;
+    }
+    if (size == TRIANGLE_SMALL) {
+        draw_small_triangle(x0, y0, x1, y1, x2, y2, point_a, point_b, point_c, no_uv, no_uv, no_uv, color, NULL);
+        return;
+    }
+
     ///////////////////////////////////////////////////////
     // Render the upper part of the triangle (flat-bottom)
     ///////////////////////////////////////////////////////
@@ -67,7 +270,10 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0,
     if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
     if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; y++) {
+        // Only the rows inside the scissor rectangle
+        int y_first = max_int(y0, scissor_rect.y_min);
+        int y_last = min_int(y1, scissor_rect.y_max - 1);
+        for (int y = y_first; y <= y_last; y++) {
             int x_start = x1 + (y - y1) * inv_slope_1;
             int x_end = x0 + (y - y0) * inv_slope_2;
 
@@ -75,9 +281,15 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0,
                 int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
             }
 
+            // Clamp the span to the scissor rectangle, so every pixel below is a valid one
+            x_start = max_int(x_start, scissor_rect.x_min);
+            x_end = min_int(x_end, scissor_rect.x_max);
+
+            uint32_t* color_row = &color_buffer[window_width * y];
+            float* depth_row = &z_buffer[window_width * y];
             for (int x = x_start; x < x_end; x++) {
                 // Draw our pixel with a solid color
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+                draw_triangle_pixel(x, y, color, color_row, depth_row, point_a, point_b, point_c);
             }
         }
     }
@@ -92,7 +304,10 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0,
     if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
     if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; y++) {
+        // Only the rows inside the scissor rectangle
+        int y_first = max_int(y1, scissor_rect.y_min);
+        int y_last = min_int(y2, scissor_rect.y_max - 1);
+        for (int y = y_first; y <= y_last; y++) {
             int x_start = x1 + (y - y1) * inv_slope_1;
             int x_end = x0 + (y - y0) * inv_slope_2;
 
@@ -100,9 +315,15 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0,
                 int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
             }
 
+            // Clamp the span to the scissor rectangle, so every pixel below is a valid one
+            x_start = max_int(x_start, scissor_rect.x_min);
+            x_end = min_int(x_end, scissor_rect.x_max);
+
+            uint32_t* color_row = &color_buffer[window_width * y];
+            float* depth_row = &z_buffer[window_width * y];
             for (int x = x_start; x < x_end; x++) {
                 // Draw our pixel with a solid color
-                draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+                draw_triangle_pixel(x, y, color, color_row, depth_row, point_a, point_b, point_c);
             }
         }
     }
@@ -172,6 +393,7 @@ vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p) {
 // for filling in color to non-textured triangles
 void draw_triangle_pixel(
     int x, int y, uint32_t color,
+    uint32_t* color_row, float* depth_row,
     vec4_t point_a, vec4_t point_b, vec4_t point_c
 ) {
     // Create three vec2 to find the interpolation
@@ -194,18 +416,20 @@ void draw_triangle_pixel(
     interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
 
     // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-    if (interpolated_reciprocal_w < z_buffer[(window_width * y) + x]) {
+    if (interpolated_reciprocal_w < depth_row[x]) {
         // Draw a pixel at position (x,y) with a solid color
-        draw_pixel(x, y, color);
+        // (no draw_pixel bounds check needed, the span was clamped to the scissor rectangle)
+        color_row[x] = color;
 
         // Update the z-buffer value with the 1/w of this current pixel
-        z_buffer[(window_width * y) + x] = interpolated_reciprocal_w;
+        depth_row[x] = interpolated_reciprocal_w;
     }
 }
 
 // Function to draw the textured pixel at position x and y using interpolation
 void draw_triangle_texel(
-	int x, int y, uint32_t* texture, // the pixel values I want to paint and the texture to pick the color from
+	int x, int y, const texture_t* texture, // the pixel values I want to paint and the texture to pick the color from
+	uint32_t* color_row, float* depth_row, // the color buffer and z-buffer rows of y
 	vec4_t point_a, vec4_t point_b, vec4_t point_c, // triangle vertices 
 	tex2_t a_uv, tex2_t b_uv, tex2_t c_uv // uv coordinates for each triangle vertex
 ) {
@@ -249,22 +473,26 @@ void draw_triangle_texel(
 	// hence the use of the modulo (%) to wrap around the texture in case that happens.
 	// We could of course just check if our indices are valid before drawing a pixel,
 	// but this is just an alternative solution to the problem
-	int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-	int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
+	int tex_x = abs((int)(interpolated_u * texture->width)) % texture->width;
+	int tex_y = abs((int)(interpolated_v * texture->height)) % texture->height;
 	
 	// Adjust 1/w so the pixels that are closer to the camera have smaller values (our depth goes near 0.0 for near camera and 1.0 for values at infinity/far away)
 	interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w; // again one-minus node like Unreal node!
 	
+	// maybe we should test here if the values of tex_x and tex_y 
+	// are valid indices of texture_array to prevent a buffer overflow
+	// (x itself is always valid, the span was clamped to the scissor rectangle)
+	uint32_t texel = texture->pixels[(texture->width * tex_y) + tex_x];
+
 	// Only draw the pixel if the depth value is less than the one previously stored in the z-buffer.
 	// Esentially a better alternative to the naive painter's algorithm we implemented in a previous lesson.
-	if (interpolated_reciprocal_w < z_buffer[(window_width * y) + x])
+	// In textures with cutouts, texels with a 0 alpha are holes (like around the instance of an impostor), nothing is drawn there.
+	if (interpolated_reciprocal_w < depth_row[x] && (!texture->has_cutout || (texel & 0xFF000000) != 0))
 	{
-		// maybe we should test here if the values of tex_x and tex_y 
-		// are valid indices of texture_array to prevent a buffer overflow
-		draw_pixel(x, y, texture[(texture_width * tex_y) + tex_x]);
+		color_row[x] = texel;
 		
 		// Update the z-buffer value with the 1/w of this current pixel
-		z_buffer[(window_width * y) + x] = interpolated_reciprocal_w;
+		depth_row[x] = interpolated_reciprocal_w;
 	}
 }
 
@@ -292,7 +520,7 @@ void draw_textured_triangle(
 	int x0, int y0, float z0, float w0, float u0, float v0,
 	int x1, int y1, float z1, float w1, float u1, float v1,
 	int x2, int y2, float z2, float w2, float u2, float v2,
-	uint32_t* texture)
+	const texture_t* texture)
 {
 	// The function body that follows is basically a combination of draw_filled_triangle
 	// and fill_flat_top_triangle and fillat_flat_bottom_triangle functions.
@@ -337,6 +565,19 @@ void draw_textured_triangle(
 	v1 = 1.0 - v1;
 	v2 = 1.0 - v2;
 	
+	// Zero area triangles don't cover any pixel
+	enum triangle_size size = classify_triangle(x0, y0, x1, y1, x2, y2);
+	if (size == TRIANGLE_DEGENERATE)
+	{
+		return;
+	}
+
+	// Skip the whole triangle setup if it's entirely outside of the scissor rectangle
+	if (!triangle_in_scissor_rect(x0, x1, x2, y0, y2))
+	{
+		return;
+	}
+
 	// Create vector points and texture coords after we sort the vertices
 	vec4_t point_a = { x0, y0, z0, w0 };
 	vec4_t point_b = { x1, y1, z1, w1 };
@@ -346,6 +587,18 @@ void draw_textured_triangle(
 	tex2_t b_uv = { u1, v1 };
 	tex2_t c_uv = { u2, v2 };
 
+	// Tiny triangles don't need the slopes and the split below
+	if (size == TRIANGLE_POINT)
+	{
+		draw_point_triangle(x0, y0, x1, y1, x2, y2, point_a, point_b, point_c, a_uv, b_uv, c_uv, 0, texture);
+		return;
+	}
+	if (size == TRIANGLE_SMALL)
+	{
+		draw_small_triangle(x0, y0, x1, y1, x2, y2, point_a, point_b, point_c, a_uv, b_uv, c_uv, 0, texture);
+		return;
+	}
+
 	//////////////////////////////////////////////////////
 	// Render the upper part of the triangle (flat-bottom)
 	//////////////////////////////////////////////////////
@@ -356,7 +609,10 @@ void draw_textured_triangle(
 
 	if ((y1 - y0) != 0) // small fix for lines drawing in flat top triangles
 	{
-		for (int y = y0; y <= y1; y++)
+		// Only the rows inside the scissor rectangle
+		int y_first = max_int(y0, scissor_rect.y_min);
+		int y_last = min_int(y1, scissor_rect.y_max - 1);
+		for (int y = y_first; y <= y_last; y++)
 		{
 			int x_start = x1 + ((y - y1) * inv_slope1);
 			int x_end = x0 + ((y - y0) * inv_slope2);
@@ -369,9 +625,15 @@ void draw_textured_triangle(
 				int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
 			}
 
+			// Clamp the span to the scissor rectangle, so every texel below is a valid one
+			x_start = max_int(x_start, scissor_rect.x_min);
+			x_end = min_int(x_end, scissor_rect.x_max);
+
+			uint32_t* color_row = &color_buffer[window_width * y];
+			float* depth_row = &z_buffer[window_width * y];
 			for (int x = x_start; x < x_end; x++)
 			{
-				draw_triangle_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+				draw_triangle_texel(x, y, texture, color_row, depth_row, point_a, point_b, point_c, a_uv, b_uv, c_uv);
 			}
 		}
 	}
@@ -386,7 +648,10 @@ void draw_textured_triangle(
 
 	if ((y2 - y1) != 0) // small fix for lines drawing in flat top triangles
 	{
-		for (int y = y1; y <= y2; y++)
+		// Only the rows inside the scissor rectangle
+		int y_first = max_int(y1, scissor_rect.y_min);
+		int y_last = min_int(y2, scissor_rect.y_max - 1);
+		for (int y = y_first; y <= y_last; y++)
 		{
 			int x_start = x1 + ((y - y1) * inv_slope1);
 			int x_end = x0 + ((y - y0) * inv_slope2);
@@ -399,9 +664,15 @@ void draw_textured_triangle(
 				int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
 			}
 
+			// Clamp the span to the scissor rectangle, so every texel below is a valid one
+			x_start = max_int(x_start, scissor_rect.x_min);
+			x_end = min_int(x_end, scissor_rect.x_max);
+
+			uint32_t* color_row = &color_buffer[window_width * y];
+			float* depth_row = &z_buffer[window_width * y];
 			for (int x = x_start; x < x_end; x++)
 			{
-				draw_triangle_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+				draw_triangle_texel(x, y, texture, color_row, depth_row, point_a, point_b, point_c, a_uv, b_uv, c_uv);
 			}
 		}
 	}
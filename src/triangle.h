@@ -6,21 +6,57 @@
 #include "vector.h"
 
 typedef struct {
-	int a;
+	int a; // vertex (position) indices
 	int b;
 	int c;
-	tex2_t a_uv;
-	tex2_t b_uv;
-	tex2_t c_uv;
-	uint32_t color;
-} face_t; // stores vertex indices for each face/triangle of a mesh
+	int a_uv; // texture coordinate indices
+	int b_uv;
+	int c_uv;
+	int a_normal; // vertex normal indices, -1 when the mesh has no normals for this face
+	int b_normal;
+	int c_normal;
+} face_t; // stores vertex/uv/normal indices for each face/triangle of a hand written mesh (like the cube in mesh.c)
 
 typedef struct {
 	vec4_t points[3];
 	tex2_t texcoords[3];
 	uint32_t color;
+	const texture_t* texture; // texture of the mesh instance the triangle came from, NULL if it has none
 } triangle_t; // stores the actual vec2 points of the triangle in the screen
 
+// Triangle setup sorts every filled/textured triangle by the screen size of its snapped vertices:
+// - zero area triangles can't cover any pixel and are dropped right away
+// - triangles that fit in a 1x1 pixel box always cover exactly one pixel, drawn as a point
+// - small triangles (bounding box up to SMALL_TRIANGLE_MAX_SIZE pixels) go to a bounding box
+//   rasterizer, their setup is cheaper than the slopes and the flat-top/flat-bottom split
+// - everything else goes through the scanline rasterizer
+// All paths cover the same pixels the scanline rasterizer would.
+#define SMALL_TRIANGLE_MAX_SIZE 8
+
+enum triangle_size
+{
+	TRIANGLE_DEGENERATE,
+	TRIANGLE_POINT,
+	TRIANGLE_SMALL,
+	TRIANGLE_LARGE,
+	NUM_TRIANGLE_SIZES
+};
+
+// Bucket 0 counts zero area triangles, bucket 1 the ones under 1 pixel,
+// and every bucket i after that the areas in [2^(i-2), 2^(i-1)) pixels (the last one is open ended)
+#define NUM_TRIANGLE_AREA_BUCKETS 16
+
+// Per frame triangle counts, to tune the thresholds above (press H to print them)
+typedef struct {
+	int num_triangles[NUM_TRIANGLE_SIZES];
+	int area_histogram[NUM_TRIANGLE_AREA_BUCKETS];
+} triangle_stats_t;
+
+extern triangle_stats_t triangle_stats;
+
+void reset_triangle_stats(void);
+void print_triangle_stats(void);
+
 // Note: Pikuma has draw_triangle moved here in lesson "Texture Typedef".
 // However I do not recall moving the function here in any of the lessons.
 // For the time being I'll keep the draw_triangle function in display.h/.c
@@ -35,14 +71,18 @@ void draw_filled_triangle(
     uint32_t color
 );
 
+// The per pixel functions write straight into the color buffer and z-buffer rows of y,
+// x must already be inside the scissor rectangle (see display.h)
 void draw_triangle_texel(
-	int x, int y, uint32_t* texture, // the pixel values I want to paint and the texture to pick the color from
+	int x, int y, const texture_t* texture, // the pixel values I want to paint and the texture to pick the color from
+	uint32_t* color_row, float* depth_row, // the color buffer and z-buffer rows of y
 	vec4_t point_a, vec4_t point_b, vec4_t point_c, // triangle vertices 
 	tex2_t a_uv, tex2_t b_uv, tex2_t c_uv // uv coordinates for each triangle vertex
 );
 
 void draw_triangle_pixel(
     int x, int y, uint32_t color,
+    uint32_t* color_row, float* depth_row,
     vec4_t point_a, vec4_t point_b, vec4_t point_c
 );
 
@@ -51,7 +91,7 @@ void draw_textured_triangle(
 	int x0, int y0, float z0, float w0, float u0, float v0, // vertex A
 	int x1, int y1, float z1, float w1, float u1, float v1, // vertex B
 	int x2, int y2, float z2, float w2, float u2, float v2, // vertex C
-	uint32_t* texture
+	const texture_t* texture
 );
 
 #endif
@@ -0,0 +1,191 @@
+#include <stdbool.h>
+#include <string.h> // for memset
+#include <SDL.h>    // for SDL_HasAVX2 and SDL_AtomicGet
+#include "vertex_stream.h"
+
+// The AVX2 kernels are compiled on any x86 compiler, without having to build the whole
+// program for AVX2: GCC/Clang enable it for those functions only (target attribute),
+// MSVC allows the intrinsics anywhere. Which version runs is decided at runtime.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VERTEX_STREAM_AVX2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+#endif
+
+void vertex_stream_build(vertex_stream_t* stream, const vec3_t* vertices, int count, arena_t* arena)
+{
+    int padded_count = (count + VERTEX_STREAM_BATCH - 1) / VERTEX_STREAM_BATCH * VERTEX_STREAM_BATCH;
+
+    // One allocation for the 3 arrays, aligned for AVX loads (see ARENA_ALIGNMENT).
+    // padded_count is a multiple of 8 floats (32 bytes), so y and z stay aligned too.
+    float* data = (float*)arena_alloc(arena, sizeof(float) * 3 * padded_count);
+    if (data == NULL)
+        padded_count = count = 0;
+    stream->x = data;
+    stream->y = data + padded_count;
+    stream->z = data + padded_count * 2;
+    stream->count = count;
+    stream->padded_count = padded_count;
+
+    for (int i = 0; i < count; i++)
+    {
+        stream->x[i] = vertices[i].x;
+        stream->y[i] = vertices[i].y;
+        stream->z[i] = vertices[i].z;
+    }
+
+    // Padding vertices sit at the origin, they get transformed like the rest but nobody looks at them
+    int padding = padded_count - count;
+    memset(stream->x + count, 0, sizeof(float) * padding);
+    memset(stream->y + count, 0, sizeof(float) * padding);
+    memset(stream->z + count, 0, sizeof(float) * padding);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar version, for CPUs without AVX2.
+// It does the exact same float operations in the same order as the AVX2 one
+// (and as mat4_mul_vec4), so both versions give bit for bit the same results.
+///////////////////////////////////////////////////////////////////////////////
+static void project_vertex_stream_scalar(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, int first, int count, vec4_t* out)
+{
+    const float (*m)[4] = matrix->m;
+    float half_width = viewport_width / 2.0f;
+    float half_height = viewport_height / 2.0f;
+
+    for (int i = first; i < first + count; i++)
+    {
+        float x = stream->x[i];
+        float y = stream->y[i];
+        float z = stream->z[i];
+        vec4_t clip = {
+            m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3],
+            m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3],
+            m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3],
+            m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3]
+        };
+
+        // Perspective divide with the original z-value that is now stored in w
+        if (clip.w != 0.0f)
+        {
+            clip.x /= clip.w;
+            clip.y /= clip.w;
+            clip.z /= clip.w;
+        }
+
+        // Scale into the view and translate to the middle of the screen,
+        // inverting the y values to account for the flipped screen y coordinate
+        out[i].x = clip.x * half_width + half_width;
+        out[i].y = clip.y * -half_height + half_height;
+        out[i].z = clip.z;
+        out[i].w = clip.w;
+    }
+}
+
+#ifdef VERTEX_STREAM_AVX2
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 version, 8 vertices per iteration.
+// Each matrix element is broadcast to a whole register once, and then every
+// output coordinate of 8 vertices is 4 multiplies and 3 adds.
+///////////////////////////////////////////////////////////////////////////////
+
+// Row r of the matrix times 8 vertices, with the same operation order as the scalar version
+#define MATRIX_ROW_TIMES_BATCH(r, x, y, z) \
+    _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r][0], x), _mm256_mul_ps(m[r][1], y)), _mm256_mul_ps(m[r][2], z)), m[r][3])
+
+// Turn 4 registers of 8 x, y, z and w values into 8 consecutive vec4_t
+AVX2_FUNCTION static void store_batch_transposed(vec4_t* out, __m256 x, __m256 y, __m256 z, __m256 w)
+{
+    __m256 xy_low = _mm256_unpacklo_ps(x, y);  // x0 y0 x1 y1 | x4 y4 x5 y5
+    __m256 xy_high = _mm256_unpackhi_ps(x, y); // x2 y2 x3 y3 | x6 y6 x7 y7
+    __m256 zw_low = _mm256_unpacklo_ps(z, w);  // z0 w0 z1 w1 | z4 w4 z5 w5
+    __m256 zw_high = _mm256_unpackhi_ps(z, w); // z2 w2 z3 w3 | z6 w6 z7 w7
+
+    __m256 v04 = _mm256_shuffle_ps(xy_low, zw_low, _MM_SHUFFLE(1, 0, 1, 0));   // vertex 0 | vertex 4
+    __m256 v15 = _mm256_shuffle_ps(xy_low, zw_low, _MM_SHUFFLE(3, 2, 3, 2));   // vertex 1 | vertex 5
+    __m256 v26 = _mm256_shuffle_ps(xy_high, zw_high, _MM_SHUFFLE(1, 0, 1, 0)); // vertex 2 | vertex 6
+    __m256 v37 = _mm256_shuffle_ps(xy_high, zw_high, _MM_SHUFFLE(3, 2, 3, 2)); // vertex 3 | vertex 7
+
+    float* destination = (float*)out;
+    _mm256_storeu_ps(destination + 0, _mm256_permute2f128_ps(v04, v15, 0x20));
+    _mm256_storeu_ps(destination + 8, _mm256_permute2f128_ps(v26, v37, 0x20));
+    _mm256_storeu_ps(destination + 16, _mm256_permute2f128_ps(v04, v15, 0x31));
+    _mm256_storeu_ps(destination + 24, _mm256_permute2f128_ps(v26, v37, 0x31));
+}
+
+AVX2_FUNCTION static void broadcast_matrix(const mat4_t* matrix, __m256 m[4][4])
+{
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            m[r][c] = _mm256_set1_ps(matrix->m[r][c]);
+}
+
+AVX2_FUNCTION static void project_vertex_stream_avx2(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, int first, int count, vec4_t* out)
+{
+    __m256 m[4][4];
+    broadcast_matrix(matrix, m);
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 half_width = _mm256_set1_ps(viewport_width / 2.0f);
+    __m256 half_height = _mm256_set1_ps(viewport_height / 2.0f);
+    __m256 minus_half_height = _mm256_set1_ps(-(viewport_height / 2.0f));
+
+    for (int i = first; i < first + count; i += VERTEX_STREAM_BATCH)
+    {
+        __m256 x = _mm256_load_ps(stream->x + i);
+        __m256 y = _mm256_load_ps(stream->y + i);
+        __m256 z = _mm256_load_ps(stream->z + i);
+
+        __m256 clip_x = MATRIX_ROW_TIMES_BATCH(0, x, y, z);
+        __m256 clip_y = MATRIX_ROW_TIMES_BATCH(1, x, y, z);
+        __m256 clip_z = MATRIX_ROW_TIMES_BATCH(2, x, y, z);
+        __m256 clip_w = MATRIX_ROW_TIMES_BATCH(3, x, y, z);
+
+        // Perspective divide, leaving the lanes with w == 0 untouched
+        __m256 has_w = _mm256_cmp_ps(clip_w, zero, _CMP_NEQ_OQ);
+        clip_x = _mm256_blendv_ps(clip_x, _mm256_div_ps(clip_x, clip_w), has_w);
+        clip_y = _mm256_blendv_ps(clip_y, _mm256_div_ps(clip_y, clip_w), has_w);
+        clip_z = _mm256_blendv_ps(clip_z, _mm256_div_ps(clip_z, clip_w), has_w);
+
+        // Viewport mapping, y flipped
+        __m256 screen_x = _mm256_add_ps(_mm256_mul_ps(clip_x, half_width), half_width);
+        __m256 screen_y = _mm256_add_ps(_mm256_mul_ps(clip_y, minus_half_height), half_height);
+
+        store_batch_transposed(&out[i], screen_x, screen_y, clip_z, clip_w);
+    }
+}
+#endif
+
+static bool use_avx2(void)
+{
+#ifdef VERTEX_STREAM_AVX2
+    // Asking the CPU every frame is not free, ask once.
+    // Atomic as the render threads can get here first at the same time (they all store the same answer).
+    static SDL_atomic_t has_avx2 = { -1 };
+    if (SDL_AtomicGet(&has_avx2) < 0)
+        SDL_AtomicSet(&has_avx2, SDL_HasAVX2() ? 1 : 0);
+    return SDL_AtomicGet(&has_avx2) == 1;
+#else
+    return false;
+#endif
+}
+
+void project_vertex_stream(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, vec4_t* out)
+{
+    project_vertex_stream_range(stream, matrix, viewport_width, viewport_height, 0, stream->padded_count, out);
+}
+
+void project_vertex_stream_range(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, int first, int count, vec4_t* out)
+{
+#ifdef VERTEX_STREAM_AVX2
+    if (use_avx2())
+    {
+        project_vertex_stream_avx2(stream, matrix, viewport_width, viewport_height, first, count, out);
+        return;
+    }
+#endif
+    project_vertex_stream_scalar(stream, matrix, viewport_width, viewport_height, first, count, out);
+}
@@ -0,0 +1,35 @@
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include "vector.h"
+#include "matrix.h"
+#include "arena.h"
+
+#define VERTEX_STREAM_BATCH 8 // vertices per iteration of the batch kernels (one AVX register of floats)
+
+// Structure of arrays copy of the mesh vertex positions, for the per-frame transform.
+// With all the x together (then all the y, then all the z) a single load
+// fills a SIMD register with the same coordinate of 8 vertices.
+// Every array is padded with zeros to padded_count, so the kernels only ever deal with full batches,
+// and the arrays they write to must hold padded_count vertices too.
+typedef struct {
+    float* x;
+    float* y;
+    float* z;
+    int count;        // number of actual vertices
+    int padded_count; // count rounded up to a multiple of VERTEX_STREAM_BATCH
+} vertex_stream_t;
+
+// The arrays are allocated from arena, and go away with it
+void vertex_stream_build(vertex_stream_t* stream, const vec3_t* vertices, int count, arena_t* arena);
+
+// out[i] = matrix * (x[i], y[i], z[i], 1) with a (world-view-)projection matrix, followed by the perspective divide
+// and the mapping to a viewport_width x viewport_height screen (y pointing down).
+// The resulting w is the clip space w (the camera space depth), for perspective correct interpolation.
+void project_vertex_stream(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, vec4_t* out);
+
+// Same, only for the count vertices starting at first (both multiples of VERTEX_STREAM_BATCH).
+// The results still go to out[first] to out[first + count - 1], the rest of out is left alone.
+void project_vertex_stream_range(const vertex_stream_t* stream, const mat4_t* matrix, float viewport_width, float viewport_height, int first, int count, vec4_t* out);
+
+#endif